@@ -34,6 +34,22 @@ clientwin_cmp_func(dlist *l, void *data) {
 		|| cw == (ClientWin *) data;
 }
 
+ClientWin *
+clientwin_find(MainWin *mw, Window wid) {
+	ClientWin *cw = winmap_get(mw->clients_by_wid, wid);
+	if (!cw)
+		cw = winmap_get(mw->clients_by_src, wid);
+	// desktop minis of paging mode are not clients
+	if (cw && cw->mode == CLIDISP_DESKTOP)
+		return NULL;
+	return cw;
+}
+
+ClientWin *
+clientwin_find_mini(MainWin *mw, Window wid) {
+	return winmap_get(mw->clients_by_mini, wid);
+}
+
 void XRoundedRectTint(session_t *ps,
 		Picture dst,
 		XRenderColor *tint,
@@ -41,7 +57,7 @@ void XRoundedRectTint(session_t *ps,
 		int w, int h,
 		int radius);
 
-void clientwin_round_corners(ClientWin *cw);
+void clientwin_round_corners(ClientWin *cw, bool settled);
 
 int
 clientwin_validate_panel(dlist *l, void *data) {
@@ -184,6 +200,13 @@ clientwin_create(MainWin *mw, Window client) {
 	// this is to be done as early as possible
 	//XSelectInput(cw->mainwin->ps->dpy, cw->src.window, SubstructureNotifyMask | StructureNotifyMask);
 
+	// PropertyNotify keeps the property cache in cw->props current
+	XSelectInput(ps->dpy, cw->wid_client, PropertyChangeMask);
+
+	winmap_set(mw->clients_by_wid, cw->wid_client, cw);
+	winmap_set(mw->clients_by_src, cw->src.window, cw);
+	winmap_set(mw->clients_by_mini, cw->mini.window, cw);
+
 	return cw;
 
 clientwin_create_err:
@@ -233,9 +256,18 @@ bool
 clientwin_update(ClientWin *cw) {
 	session_t *ps = cw->mainwin->ps;
 
+	if (cw->tracked) {
+		cw->src.x = cw->src0.x;
+		cw->src.y = cw->src0.y;
+		cw->src.width = cw->src0.width;
+		cw->src.height = cw->src0.height;
+		return true;
+	}
+
 	// Get window attributes
 	XWindowAttributes wattr = { };
 	XGetWindowAttributes(ps->dpy, cw->src.window, &wattr);
+	cw->map_state = wattr.map_state;
 
 	{
 		Window tmpwin = None;
@@ -261,26 +293,130 @@ clientwin_update(ClientWin *cw) {
 	return true;
 }
 
+/**
+ * clientwin_update() for a list of clients, with the requests of all of
+ * them pipelined over XCB: the geometries and attributes first, then the
+ * coordinates, so the whole list costs two round trips. Clients whose geometry can't
+ * be had that way, or is already tracked, go through clientwin_update().
+ */
+void
+clientwin_update_all(MainWin *mw, dlist *clients) {
+	session_t *ps = mw->ps;
+	int n = dlist_len(clients);
+	if (!n)
+		return;
+
+	ClientWin **cws = smalloc(n, ClientWin *);
+	xcb_get_geometry_cookie_t *geometry = smalloc(n, xcb_get_geometry_cookie_t);
+	xcb_get_geometry_reply_t **geometry_r = scalloc(n, xcb_get_geometry_reply_t *);
+	xcb_get_window_attributes_cookie_t *attributes = smalloc(n,
+			xcb_get_window_attributes_cookie_t);
+	xcb_translate_coordinates_cookie_t *translate = smalloc(n,
+			xcb_translate_coordinates_cookie_t);
+
+	// Xlib requests still buffered must not be overtaken
+	XFlush(ps->dpy);
+	xcb_connection_t *c = XGetXCBConnection(ps->dpy);
+
+	int i = 0;
+	foreach_dlist (clients) {
+		ClientWin *cw = iter->data;
+		if (cw->tracked) {
+			clientwin_update(cw);
+			continue;
+		}
+		cws[i] = cw;
+		geometry[i] = xcb_get_geometry(c, cw->src.window);
+		attributes[i] = xcb_get_window_attributes(c, cw->src.window);
+		i++;
+	}
+	n = i;
+
+	for (i = 0; i < n; i++) {
+		xcb_generic_error_t *err = NULL;
+		geometry_r[i] = xcb_get_geometry_reply(c, geometry[i], &err);
+		free(err);
+		err = NULL;
+		xcb_get_window_attributes_reply_t *a =
+			xcb_get_window_attributes_reply(c, attributes[i], &err);
+		free(err);
+		if (a) {
+			cws[i]->map_state = a->map_state;
+			free(a);
+		}
+		else if (geometry_r[i]) {
+			free(geometry_r[i]);
+			geometry_r[i] = NULL;
+		}
+		// a window of no size is measured by its client window instead
+		if (geometry_r[i] && !geometry_r[i]->width && !geometry_r[i]->height) {
+			free(geometry_r[i]);
+			geometry_r[i] = NULL;
+		}
+		if (geometry_r[i])
+			translate[i] = xcb_translate_coordinates(c, cws[i]->src.window,
+					geometry_r[i]->root,
+					-geometry_r[i]->border_width, -geometry_r[i]->border_width);
+	}
+
+	for (i = 0; i < n; i++) {
+		ClientWin *cw = cws[i];
+		if (!geometry_r[i]) {
+			clientwin_update(cw);
+			continue;
+		}
+
+		xcb_generic_error_t *err = NULL;
+		xcb_translate_coordinates_reply_t *r =
+			xcb_translate_coordinates_reply(c, translate[i], &err);
+		free(err);
+		if (r) {
+			cw->src.x = r->dst_x;
+			cw->src.y = r->dst_y;
+			free(r);
+		}
+
+		cw->src.width = geometry_r[i]->width;
+		cw->src.height = geometry_r[i]->height;
+		cw->src0.x = cw->src.x;
+		cw->src0.y = cw->src.y;
+		cw->src0.width = cw->src.width;
+		cw->src0.height = cw->src.height;
+		free(geometry_r[i]);
+	}
+
+	free(translate);
+	free(attributes);
+	free(geometry_r);
+	free(geometry);
+	free(cws);
+}
+
 bool
 clientwin_update3(ClientWin *cw) {
 	session_t *ps = cw->mainwin->ps;
 
 	clientwin_free_res2(ps, cw);
 
-	XWindowAttributes wattr = { };
-	XGetWindowAttributes(ps->dpy, cw->src.window, &wattr);
-	bool isViewable = wattr.map_state == IsViewable;
+	// the visual of a window never changes, so a tracked window with a
+	// known format needs no query
+	if (!cw->tracked || !cw->src.format) {
+		XWindowAttributes wattr = { };
+		XGetWindowAttributes(ps->dpy, cw->src.window, &wattr);
+		cw->map_state = wattr.map_state;
+		cw->src.format = XRenderFindVisualFormat(ps->dpy, wattr.visual);
+	}
+	bool isViewable = cw->map_state == IsViewable;
 
 	cw->zombie = !isViewable;
 
-	cw->src.format = XRenderFindVisualFormat(ps->dpy, wattr.visual);
-
 	if (ps->o.tooltip_show && !cw->tooltip)
 		cw->tooltip = tooltip_create(cw->mainwin);
 
 	if (isViewable) {
 		static XRenderPictureAttributes pa = { .subwindow_mode = IncludeInferiors };
 
+		cw->thumb_source = None;
 		if (cw->origin)
 			free_picture(ps, &cw->origin);
 		cw->origin = XRenderCreatePicture(ps->dpy,
@@ -340,6 +476,12 @@ clientwin_update3(ClientWin *cw) {
 bool
 clientwin_detect_change(ClientWin *cw) {
 	session_t *ps = cw->mainwin->ps;
+
+	if (cw->tracked)
+		return cw->src0.x != cw->src.x || cw->src0.y != cw->src.y
+			|| cw->src0.width != cw->src.width || cw->src0.height != cw->src.height
+			|| (cw->map_state == IsViewable) != !cw->zombie;
+
 	XWindowAttributes wattr = { };
 	XGetWindowAttributes(ps->dpy, cw->src.window, &wattr);
 
@@ -362,6 +504,62 @@ clientwin_detect_change(ClientWin *cw) {
 	return false;
 }
 
+/**
+ * Follow the geometry and map state of the clients whose src.window is a
+ * child of the root window, from the root's SubstructureNotify events.
+ *
+ * A ConfigureNotify from the root carries the outer corner in root
+ * coordinates, exactly what clientwin_update() asks XTranslateCoordinates()
+ * for. A resize of the root moves the children of non-default gravity
+ * with a GravityNotify instead. A reparent makes the position relative
+ * to some other window, so such a client goes back to querying the
+ * server.
+ */
+void
+clientwin_track(MainWin *mw, const XEvent *ev) {
+	session_t *ps = mw->ps;
+	ClientWin *cw = NULL;
+
+	switch (ev->type) {
+		case ConfigureNotify:
+			if (ev->xconfigure.event != ps->root
+					|| !(cw = winmap_get(mw->clients_by_src, ev->xconfigure.window)))
+				break;
+			cw->src0.x = ev->xconfigure.x;
+			cw->src0.y = ev->xconfigure.y;
+			cw->src0.width = ev->xconfigure.width;
+			cw->src0.height = ev->xconfigure.height;
+			// a frame of no size is measured by its client window,
+			// which only the server knows about
+			cw->tracked = cw->map_state >= 0
+				&& (ev->xconfigure.width || ev->xconfigure.height);
+			break;
+		case GravityNotify:
+			if (ev->xgravity.event == ps->root
+					&& (cw = winmap_get(mw->clients_by_src, ev->xgravity.window))) {
+				cw->src0.x = ev->xgravity.x;
+				cw->src0.y = ev->xgravity.y;
+			}
+			break;
+		case MapNotify:
+			if (ev->xmap.event == ps->root
+					&& (cw = winmap_get(mw->clients_by_src, ev->xmap.window)))
+				cw->map_state = IsViewable;
+			break;
+		case UnmapNotify:
+			if (ev->xunmap.event == ps->root
+					&& (cw = winmap_get(mw->clients_by_src, ev->xunmap.window)))
+				cw->map_state = IsUnmapped;
+			break;
+		case ReparentNotify:
+			if ((cw = winmap_get(mw->clients_by_src, ev->xreparent.window))) {
+				cw->tracked = false;
+				cw->map_state = -1;
+			}
+			break;
+	}
+}
+
 static inline bool
 clientwin_update2_desktop(session_t *ps, MainWin *mw, ClientWin *cw) {
 	if (cw->pict_filled)
@@ -437,10 +635,20 @@ clientwin_destroy(ClientWin *cw, bool destroyed) {
 	MainWin *mw = cw->mainwin;
 	session_t * const ps = mw->ps;
 
+	winmap_remove(mw->clients_by_wid, cw->wid_client, cw);
+	winmap_remove(mw->clients_by_src, cw->src.window, cw);
+	winmap_remove(mw->clients_by_mini, cw->mini.window, cw);
+	if (cw->dirty)
+		cwvec_remove(&mw->dirty, cwvec_index_of(&mw->dirty, cw));
+
 	if (ps->o.pseudoTrans)
 		free_picture(ps, &cw->origin);
 	free_picture(ps, &cw->destination);
 	free_picture(ps, &cw->shadow);
+	free_picture(ps, &cw->thumb);
+	free_pixmap(ps, &cw->thumb_pixmap);
+	free_picture(ps, &cw->snapshot);
+	free_pixmap(ps, &cw->snapshot_pixmap);
 	free_pixmap(ps, &cw->pixmap);
 	free_pixmap(ps, &cw->cpixmap);
 	free_pictw(ps, &cw->icon_pict);
@@ -451,11 +659,16 @@ clientwin_destroy(ClientWin *cw, bool destroyed) {
 	if (cw->tooltip)
 		tooltip_destroy(cw->tooltip);
 
+	wm_props_free(&cw->props);
+
 	if (cw->src.window && !destroyed) {
 		free_damage(ps, &cw->damage);
+		free_damage(ps, &cw->snapshot_damage);
 		// Stop listening to events, this should be safe because we don't
 		// monitor window re-map anyway
 		XSelectInput(ps->dpy, cw->src.window, 0);
+		if (cw->wid_client != cw->src.window)
+			XSelectInput(ps->dpy, cw->wid_client, 0);
 
 		if (cw->redirected)
 			XCompositeUnredirectWindow(ps->dpy, cw->src.window, CompositeRedirectAutomatic);
@@ -470,6 +683,136 @@ clientwin_destroy(ClientWin *cw, bool destroyed) {
 	free(cw);
 }
 
+/**
+ * The copy of source scaled to the size of the settled mini window.
+ * Repaints then copy it 1:1 instead of resampling the whole client
+ * window. It is scaled in full when it is missing, of another size or
+ * of another source. Otherwise only the damaged area pbound is scaled
+ * again, with a margin for the filter and for the rounding of scaled
+ * damage.
+ */
+static Picture
+clientwin_thumb(ClientWin *cw, Picture source, const XRectangle *pbound)
+{
+	session_t *ps = cw->mainwin->ps;
+	int w = cw->mini.width, h = cw->mini.height;
+
+	if (cw->thumb && (cw->thumb_width != w || cw->thumb_height != h)) {
+		free_picture(ps, &cw->thumb);
+		free_pixmap(ps, &cw->thumb_pixmap);
+	}
+	if (!cw->thumb) {
+		cw->thumb_pixmap = XCreatePixmap(ps->dpy, ps->root, w, h, 32);
+		cw->thumb = XRenderCreatePicture(ps->dpy, cw->thumb_pixmap,
+				XRenderFindStandardFormat(ps->dpy, PictStandardARGB32), 0, NULL);
+		cw->thumb_width = w;
+		cw->thumb_height = h;
+		cw->thumb_source = None;
+	}
+
+	if (cw->thumb_source != source) {
+		XRenderComposite(ps->dpy, PictOpSrc, source, None, cw->thumb,
+				0, 0, 0, 0, 0, 0, w, h);
+		cw->thumb_source = source;
+	}
+	else if (pbound) {
+		int x1 = MAX(pbound->x - 2, 0);
+		int y1 = MAX(pbound->y - 2, 0);
+		int x2 = MIN(pbound->x + pbound->width + 2, w);
+		int y2 = MIN(pbound->y + pbound->height + 2, h);
+		if (x1 < x2 && y1 < y2)
+			XRenderComposite(ps->dpy, PictOpSrc, source, None, cw->thumb,
+					x1, y1, 0, 0, x1, y1, x2 - x1, y2 - y1);
+	}
+
+	return cw->thumb;
+}
+
+static inline int
+clientwin_snapshot_size(int size, float scale) {
+	return MAX((int) (size * scale), 1);
+}
+
+// picture transform drawing a picture scaled by f
+static void
+clientwin_scale_transform(XTransform *transform, double f) {
+	*transform = (XTransform) { {
+		{ XDoubleToFixed(1.0 / f), 0, 0 },
+		{ 0, XDoubleToFixed(1.0 / f), 0 },
+		{ 0, 0, XDoubleToFixed(1.0) },
+	} };
+}
+
+/**
+ * Whether the snapshot of cw is missing, was taken at another scale or
+ * src.window changed since. Only live thumbnails get one.
+ */
+bool
+clientwin_snapshot_due(const ClientWin *cw, float scale) {
+	if (!cw->origin || cw->zombie || cw->mode < CLIDISP_THUMBNAIL)
+		return false;
+	return !cw->snapshot || cw->snapshot_stale
+		|| cw->snapshot_width != clientwin_snapshot_size(cw->src.width, scale)
+		|| cw->snapshot_height != clientwin_snapshot_size(cw->src.height, scale);
+}
+
+/**
+ * Take the snapshot of cw again, origin scaled by scale, while the
+ * daemon is idle. The damage object marking it stale is created with
+ * the first snapshot and emptied here, so a window that keeps drawing
+ * reports a single event per snapshot. origin is left untransformed.
+ */
+void
+clientwin_snapshot(ClientWin *cw, float scale) {
+	session_t *ps = cw->mainwin->ps;
+	int w = clientwin_snapshot_size(cw->src.width, scale);
+	int h = clientwin_snapshot_size(cw->src.height, scale);
+	XTransform transform;
+
+	if (cw->snapshot && (cw->snapshot_width != w || cw->snapshot_height != h)) {
+		free_picture(ps, &cw->snapshot);
+		free_pixmap(ps, &cw->snapshot_pixmap);
+	}
+	if (!cw->snapshot) {
+		cw->snapshot_pixmap = XCreatePixmap(ps->dpy, ps->root, w, h, 32);
+		cw->snapshot = XRenderCreatePicture(ps->dpy, cw->snapshot_pixmap,
+				XRenderFindStandardFormat(ps->dpy, PictStandardARGB32), 0, NULL);
+		XRenderSetPictureFilter(ps->dpy, cw->snapshot, FilterBilinear, 0, 0);
+		cw->snapshot_width = w;
+		cw->snapshot_height = h;
+	}
+
+	if (cw->snapshot_damage)
+		XDamageSubtract(ps->dpy, cw->snapshot_damage, None, None);
+	else
+		cw->snapshot_damage = XDamageCreate(ps->dpy, cw->src.window,
+				XDamageReportNonEmpty);
+	cw->snapshot_stale = false;
+
+	clientwin_scale_transform(&transform, scale);
+	XRenderSetPictureTransform(ps->dpy, cw->origin, &transform);
+	XRenderComposite(ps->dpy, PictOpSrc, cw->origin, None, cw->snapshot,
+			0, 0, 0, 0, 0, 0, w, h);
+	clientwin_scale_transform(&transform, 1.0);
+	XRenderSetPictureTransform(ps->dpy, cw->origin, &transform);
+}
+
+/**
+ * Whether the snapshot of cw can stand in for src.window on the first
+ * frame of a session: nothing was drawn, resized or unmapped since it
+ * was taken, so the pictures of the last clientwin_update3() are still
+ * those of the window.
+ */
+bool
+clientwin_snapshot_current(const ClientWin *cw) {
+	session_t *ps = cw->mainwin->ps;
+
+	return ps->o.snapshotCache && cw->snapshot && !cw->snapshot_stale
+		&& cw->tracked && cw->map_state == IsViewable && cw->origin
+		&& !cw->zombie && cw->mode >= CLIDISP_THUMBNAIL
+		&& cw->paneltype == WINTYPE_WINDOW;
+}
+
 static void
 clientwin_repaint(ClientWin *cw, const XRectangle *pbound)
 {
@@ -512,6 +855,12 @@ clientwin_repaint(ClientWin *cw, const XRectangle *pbound)
 
 	if (!source) return;
 
+	if (cw->from_snapshot)
+		source = cw->snapshot;
+	else if (cw->mode >= CLIDISP_ZOMBIE && cw->paneltype == WINTYPE_WINDOW
+			&& cw->settled)
+		source = clientwin_thumb(cw, source, pbound);
+
 	// Drawing main picture
 	{
 		Picture mask = mw->normalPicture;
@@ -706,40 +1055,70 @@ clientwin_render(ClientWin *cw) {
 	clientwin_repaint(cw, NULL);
 }
 
+/**
+ * Repaint the areas the XDamageNotify events reported since the last
+ * repair. The damage is subtracted on the server without fetching it
+ * back, so repairing costs no round trip: damage done after the events
+ * we read still sends events of its own.
+ */
 void
 clientwin_repair(ClientWin *cw) {
 	session_t *ps = cw->mainwin->ps;
 
-	int nrects = 0;
-	XRectangle *rects = NULL;
-
-	{
-		XserverRegion rgn = XFixesCreateRegion(ps->dpy, 0, 0);
-		XDamageSubtract(ps->dpy, cw->damage, None, rgn);
-		if (cw->mode >= CLIDISP_ZOMBIE)
-			rects = XFixesFetchRegion(ps->dpy, rgn, &nrects);
-		XFixesDestroyRegion(ps->dpy, rgn);
-	}
-	for (int i = 0; i < nrects; i++) {
-		XRectangle r = {
-			.x = rects[i].x * cw->factor,
-			.y = rects[i].y * cw->factor,
-			.width = rects[i].width * cw->factor,
-			.height = rects[i].height * cw->factor,
-		};
-		clientwin_repaint(cw, &r);
+	if (cw->damage)
+		XDamageSubtract(ps->dpy, cw->damage, None, None);
+
+	if (cw->mode >= CLIDISP_ZOMBIE) {
+		for (int i = 0; i < cw->nrepair; i++) {
+			XRectangle r = {
+				.x = cw->repair[i].x * cw->factor,
+				.y = cw->repair[i].y * cw->factor,
+				.width = cw->repair[i].width * cw->factor,
+				.height = cw->repair[i].height * cw->factor,
+			};
+			clientwin_repaint(cw, &r);
+		}
 	}
 
-	if (rects)
-		XFree(rects);
-	
+	cw->nrepair = 0;
 	cw->damaged = false;
 }
 
+static inline bool
+rect_contains(const XRectangle *a, const XRectangle *b) {
+	return a->x <= b->x && a->y <= b->y
+		&& a->x + a->width >= b->x + b->width
+		&& a->y + a->height >= b->y + b->height;
+}
+
+// note area of src.window for the next clientwin_repair()
 void
-clientwin_schedule_repair(ClientWin *cw, XRectangle *area)
+clientwin_schedule_repair(ClientWin *cw, const XRectangle *area)
 {
 	cw->damaged = true;
+
+	for (int i = 0; i < cw->nrepair; i++)
+		if (rect_contains(&cw->repair[i], area))
+			return;
+
+	if (cw->nrepair < CLIENTWIN_MAX_REPAIR) {
+		cw->repair[cw->nrepair++] = *area;
+		return;
+	}
+
+	// too many areas to keep apart: repaint their bounding box
+	int x1 = area->x, y1 = area->y;
+	int x2 = area->x + area->width, y2 = area->y + area->height;
+	for (int i = 0; i < cw->nrepair; i++) {
+		x1 = MIN(x1, cw->repair[i].x);
+		y1 = MIN(y1, cw->repair[i].y);
+		x2 = MAX(x2, cw->repair[i].x + cw->repair[i].width);
+		y2 = MAX(y2, cw->repair[i].y + cw->repair[i].height);
+	}
+	cw->repair[0] = (XRectangle) {
+		.x = x1, .y = y1, .width = x2 - x1, .height = y2 - y1,
+	};
+	cw->nrepair = 1;
 }
 
 void XRoundedRectTint(session_t *ps,
@@ -754,42 +1133,73 @@ void XRoundedRectTint(session_t *ps,
 				PictOpOver, dst, tint,
 				x, y, w, h);
 
-	Pixmap pm;
-	Picture mask = XRoundedRectMask(ps, w, h, radius, &pm);
+	Picture mask = XRoundedRectMaskCached(ps, w, h, radius);
 	Picture src = XRenderCreateSolidFill(ps->dpy, tint);
 
 	XRenderComposite(ps->dpy, PictOpOver, src, mask, dst,
 			0, 0, 0, 0, x, y, w, h);
 
 	XRenderFreePicture(ps->dpy, src);
-	XRenderFreePicture(ps->dpy, mask);
-	XFreePixmap(ps->dpy, pm);
 }
 
-void clientwin_round_corners(ClientWin *cw) {
-	session_t* ps = cw->mainwin->ps;
-	int radius = ps->o.cornerRadius * cw->mainwin->multiplier;
+// 1-bit mask of a w x h rectangle with corners of the given radius
+static Pixmap
+clientwin_corner_mask(session_t *ps, int w, int h, int radius) {
 	int dia = 2 * radius;
-	int w = cw->mini.width;
-	int h = cw->mini.height;
 	XGCValues xgcv;
-	Pixmap mask = XCreatePixmap(ps->dpy, cw->mini.window, w, h, 1);
+	Pixmap mask = XCreatePixmap(ps->dpy, ps->root, w, h, 1);
 	GC shape_gc = XCreateGC(ps->dpy, mask, 0, &xgcv);
 
 	XSetForeground(ps->dpy, shape_gc, 0);
 	XFillRectangle(ps->dpy, mask, shape_gc, 0, 0, w, h);
 	XSetForeground(ps->dpy, shape_gc, 1);
-	if (dia > 0) {
-		XFillArc(ps->dpy, mask, shape_gc, 0, 0, dia, dia, 0, 360 * 64);
-		XFillArc(ps->dpy, mask, shape_gc, w-dia-1, 0, dia, dia, 0, 360 * 64);
-		XFillArc(ps->dpy, mask, shape_gc, 0, h-dia-1, dia, dia, 0, 360 * 64);
-		XFillArc(ps->dpy, mask, shape_gc, w-dia-1, h-dia-1, dia, dia, 0, 360 * 64);
-	}
+	XFillArc(ps->dpy, mask, shape_gc, 0, 0, dia, dia, 0, 360 * 64);
+	XFillArc(ps->dpy, mask, shape_gc, w-dia-1, 0, dia, dia, 0, 360 * 64);
+	XFillArc(ps->dpy, mask, shape_gc, 0, h-dia-1, dia, dia, 0, 360 * 64);
+	XFillArc(ps->dpy, mask, shape_gc, w-dia-1, h-dia-1, dia, dia, 0, 360 * 64);
 	XFillRectangle(ps->dpy, mask, shape_gc, radius, 0, w-dia, h);
 	XFillRectangle(ps->dpy, mask, shape_gc, 0, radius, w, h-dia);
-	XShapeCombineMask(ps->dpy, cw->mini.window, ShapeBounding, 0, 0, mask, ShapeSet);
-	XFreePixmap(ps->dpy, mask);
 	XFreeGC(ps->dpy, shape_gc);
+
+	return mask;
+}
+
+/**
+ * Round the corners of the mini window, once it has settled at its
+ * final size: the frames before the last of an animation leave it
+ * rectangular, as does a radius of 0. The masks come from a cache of
+ * the main window, and a mini window already shaped for its size is
+ * left alone.
+ */
+void clientwin_round_corners(ClientWin *cw, bool settled) {
+	session_t* ps = cw->mainwin->ps;
+	int radius = ps->o.cornerRadius * cw->mainwin->multiplier;
+	int w = cw->mini.width;
+	int h = cw->mini.height;
+
+	if (!radius || !settled || w <= 0 || h <= 0) {
+		if (cw->shape_radius) {
+			XShapeCombineMask(ps->dpy, cw->mini.window, ShapeBounding,
+					0, 0, None, ShapeSet);
+			cw->shape_radius = 0;
+		}
+		return;
+	}
+
+	if (cw->shape_radius == radius
+			&& cw->shape_width == w && cw->shape_height == h)
+		return;
+
+	maskcache_t *masks = &cw->mainwin->shape_masks;
+	Pixmap mask = maskcache_get(masks, w, h, radius);
+	if (!mask) {
+		mask = clientwin_corner_mask(ps, w, h, radius);
+		maskcache_put(ps, masks, w, h, radius, mask);
+	}
+	XShapeCombineMask(ps->dpy, cw->mini.window, ShapeBounding, 0, 0, mask, ShapeSet);
+	cw->shape_width = w;
+	cw->shape_height = h;
+	cw->shape_radius = radius;
 }
 
 void clientwin_prepmove(ClientWin *cw)
@@ -833,9 +1243,35 @@ clientwin_move(ClientWin *cw, float f, int x, int y, float timeslice)
 	XMoveResizeWindow(cw->mainwin->ps->dpy, cw->mini.window,
 			cw->mini.x, cw->mini.y, cw->mini.width, cw->mini.height);
 
-	clientwin_round_corners(cw);
+	cw->settled = timeslice >= 1;
+	clientwin_round_corners(cw, cw->settled);
+}
+
+static inline void
+clientwin_set_transform(ClientWin *cw) {
+	session_t *ps = cw->mainwin->ps;
+
+	if (cw->paneltype != WINTYPE_WINDOW)
+		return;
+	if (cw->origin)
+		XRenderSetPictureTransform(ps->dpy, cw->origin, &cw->mainwin->transform);
+	if (cw->shadow)
+		XRenderSetPictureTransform(ps->dpy, cw->shadow, &cw->mainwin->transform);
+}
+
+static inline bool
+clientwin_has_tooltip(ClientWin *cw) {
+	session_t *ps = cw->mainwin->ps;
+	return ps->o.tooltip_show && ps->o.mode != PROGMODE_PAGING
+		&& cw->paneltype == WINTYPE_WINDOW;
 }
 
+/**
+ * Show the mini window when a session starts: create its damage object
+ * the first time, or empty the one kept from an earlier session, render,
+ * map and raise it. The frames of the animation after that go
+ * through clientwin_animate().
+ */
 void
 clientwin_map(ClientWin *cw) {
 	session_t *ps = cw->mainwin->ps;
@@ -843,40 +1279,95 @@ clientwin_map(ClientWin *cw) {
 	if (!cw->mode)
 		return;
 
-	if (cw->origin) {
-		free_damage(ps, &cw->damage);
-		cw->damage = XDamageCreate(ps->dpy, cw->src.window, XDamageReportDeltaRectangles);
-		if (cw->paneltype == WINTYPE_WINDOW)
-			XRenderSetPictureTransform(ps->dpy, cw->origin, &cw->mainwin->transform);
-	}
-
-	if (cw->shadow) {
-		free_damage(ps, &cw->damage);
+	// damage reported between sessions is covered by the full render below
+	cw->nrepair = 0;
+	cw->damaged = false;
+	cw->thumb_source = None;
+	if (cw->damage)
+		XDamageSubtract(ps->dpy, cw->damage, None, None);
+	else if (cw->origin || cw->shadow)
 		cw->damage = XDamageCreate(ps->dpy, cw->src.window, XDamageReportDeltaRectangles);
-		if (cw->paneltype == WINTYPE_WINDOW)
-			XRenderSetPictureTransform(ps->dpy, cw->shadow, &cw->mainwin->transform);
+	clientwin_set_transform(cw);
+
+	// the first frame comes from the idle snapshot when it is still
+	// current, the frames after it from src.window, see clientwin_live()
+	if (cw->from_snapshot) {
+		XTransform transform;
+		clientwin_scale_transform(&transform,
+				(double) cw->mini.width / cw->snapshot_width);
+		XRenderSetPictureTransform(ps->dpy, cw->snapshot, &transform);
 	}
 
 	clientwin_render(cw);
 
 	XMapWindow(ps->dpy, cw->mini.window);
 	XRaiseWindow(ps->dpy, cw->mini.window);
+	cw->mapped = true;
 
-	if (ps->o.tooltip_show && ps->o.mode != PROGMODE_PAGING
-			&& cw->paneltype == WINTYPE_WINDOW)
+	if (clientwin_has_tooltip(cw))
 		clientwin_tooltip(cw);
 }
 
+/**
+ * Run the clientwin_update3() the session deferred for a mini window
+ * drawn from its snapshot, then repaint it from src.window, so the
+ * scaled up snapshot does not stay on screen when nothing animates or
+ * damages the window.
+ */
+void
+clientwin_live(ClientWin *cw) {
+	if (!cw->from_snapshot)
+		return;
+	cw->from_snapshot = false;
+
+	clientwin_update3(cw);
+	clientwin_update2(cw);
+	if (!cw->mapped)
+		return;
+	clientwin_set_transform(cw);
+	clientwin_render(cw);
+}
+
+/**
+ * One frame of the animation of a mapped mini window, after
+ * clientwin_move(): the picture transform follows the scale and the
+ * mini window is rendered again. The damage object and the map state
+ * are left alone. The tooltip only follows the mini window until the
+ * last frame, where its label is fitted to the final size.
+ */
+void
+clientwin_animate(ClientWin *cw, bool last) {
+	if (!cw->mapped) {
+		clientwin_map(cw);
+		return;
+	}
+
+	clientwin_set_transform(cw);
+	clientwin_render(cw);
+
+	if (clientwin_has_tooltip(cw) && cw->tooltip) {
+		if (last)
+			clientwin_tooltip(cw);
+		else
+			tooltip_move(cw->tooltip, cw);
+	}
+}
+
 void
 clientwin_unmap(ClientWin *cw) {
 	session_t *ps = cw->mainwin->ps;
 
-	free_damage(ps, &cw->damage);
+	// the damage object stays for the next session, not being emptied
+	// while idle, it only reports the first change to each area
 	free_picture(ps, &cw->destination);
 	free_pixmap(ps, &cw->pixmap);
+	free_picture(ps, &cw->thumb);
+	free_pixmap(ps, &cw->thumb_pixmap);
 
 	XUnmapWindow(ps->dpy, cw->mini.window);
 	XSetWindowBackgroundPixmap(ps->dpy, cw->mini.window, None);
+	cw->mapped = false;
+	cw->from_snapshot = false;
 
 	cw->focused = false;
 
@@ -919,23 +1410,16 @@ clientwin_tooltip(ClientWin *cw) {
 				label = wm_get_window_title(ps, cw->mini.window, &len);
 		}
 		else {
-			XClassHint *hints = allocchk(XAllocClassHint());
-			if (hints) {
-				XGetClassHint(ps->dpy, cw->wid_client, hints);
-				if (hints->res_class)
-					label = (unsigned char*)hints->res_class;
-				else if (hints->res_name)
-					label = (unsigned char*)hints->res_name;
-
-				len = (!label) ? 0 : strlen((char*)label);
-
-				//if (hints->res_class)
-					//XFree(hints->res_class);
-				if (hints->res_name)
-					XFree(hints->res_name);
-				if (hints)
-					XFree(hints);
+			char *res_class = NULL, *res_name = NULL;
+			wm_get_window_class(ps, cw->wid_client, &res_class, &res_name);
+			if (res_class) {
+				label = (unsigned char*) res_class;
+				free(res_name);
 			}
+			else
+				label = (unsigned char*) res_name;
+
+			len = (!label) ? 0 : strlen((char*)label);
 		}
 
 		if (label) {
@@ -999,15 +1483,18 @@ close_clientwindow(ClientWin* cw, enum cliop op) {
 		mw->clients = dlist_remove(del);
 	}
 
-	{
-		dlist *del = dlist_find(mw->focuslist,
-				clientwin_cmp_func, (void *) cw->wid_client);
-		mw->focuslist = dlist_remove(del);
-	}
+	// the window may outlive the request, so have count_clients()
+	// look at the stack again even if it has not changed
+	free(mw->stack);
+	mw->stack = NULL;
+	mw->nstack = 0;
+
+	cwvec_remove(&mw->focuslist, focuslist_index_of(&mw->focuslist, cw));
+	focuslist_reindex(&mw->focuslist);
 
-	clientwin_destroy((ClientWin *) cw, True);
+	clientwin_destroy((ClientWin *) cw, False);
 
-	if (dlist_len(mw->focuslist) == 0)
+	if (mw->focuslist.len == 0)
 		return 1;
 	return 0;
 }
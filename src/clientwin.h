@@ -31,12 +31,20 @@ typedef struct {
 
 struct _Tooltip;
 
+// damaged areas kept apart before they are merged into one box
+#define CLIENTWIN_MAX_REPAIR 16
+
 struct _clientwin_t {
 	MainWin *mainwin;
 
 	client_disp_mode_t mode;
 	Window wid_client;
 	SkippyWindow src, src0;
+	/* src0 and map_state follow the root window's SubstructureNotify
+	 * events, as src.window is known to be a child of the root window */
+	bool tracked;
+	/* IsViewable and friends, -1 until first queried */
+	int map_state;
 	bool redirected;
 	Pixmap cpixmap;
 	pictw_t *pict_filled;
@@ -49,29 +57,67 @@ struct _clientwin_t {
 
 	Pixmap pixmap;
 	Picture origin, destination, shadow;
+	/* origin or shadow scaled to the settled mini window, and the one of
+	 * them it was scaled from, see clientwin_thumb() */
+	Pixmap thumb_pixmap;
+	Picture thumb, thumb_source;
+	int thumb_width, thumb_height;
+	/* origin scaled down while the daemon is idle, shown on the first
+	 * frame of a session, see clientwin_snapshot() */
+	Pixmap snapshot_pixmap;
+	Picture snapshot;
+	int snapshot_width, snapshot_height;
+	/* XDamageReportNonEmpty damage of src.window, set off once by the
+	 * first change after the snapshot */
+	Damage snapshot_damage;
+	bool snapshot_stale;
+	/* the repaint draws from the snapshot and clientwin_update3() waits
+	 * for the first frame, see clientwin_live() */
+	bool from_snapshot;
 	Damage damage;
 	float factor;
 
 	bool focused;
+	/* position in mainwin->focuslist, see focuslist_reindex() */
+	int focus_index;
 	bool multiselect;
 	bool damaged;
+	/* mini.window is mapped, see clientwin_map() */
+	bool mapped;
+	/* mini.window is at the end of its animation */
+	bool settled;
+	/* Size and corner radius mini.window is shaped for, radius 0 if it
+	 * isn't shaped */
+	int shape_width, shape_height, shape_radius;
 
 	bool zombie;
 	wintype_t paneltype;
-	/* XserverRegion repair; */
+	/* Areas of src.window damaged since the last repair, as reported by
+	 * XDamageNotify events */
+	XRectangle repair[CLIENTWIN_MAX_REPAIR];
+	int nrepair;
 	
 	/* These are virtual positions set by the layout routine */
 	int x, y;
-	float fx, fy, fx2, fy2, vx, vy;
 	struct _Tooltip *tooltip;
     int slots;
+
+	/* Properties of wid_client, see wm_props_t */
+	wm_props_t props;
+	/* CW_DIRTY_* bits of what changed while idle, see MainWin.dirty */
+	unsigned dirty;
 };
 
+#define CW_DIRTY_GEOMETRY (1 << 0)
+#define CW_DIRTY_ICON     (1 << 1)
+#define CW_DIRTY_STATE    (1 << 2)
+
 #define CLIENTWT_INIT { \
 	.src = SKIPPYWINT_INIT, \
 	.mini = SKIPPYWINT_INIT, \
 	.mainwin = NULL, \
-	.icon_tried = false \
+	.icon_tried = false, \
+	.map_state = -1, \
 }
 
 client_disp_mode_t
@@ -100,17 +146,28 @@ void clientwin_destroy(ClientWin *, bool destroyed);
 void clientwin_prepmove(ClientWin *);
 void clientwin_move(ClientWin *, float, int, int, float);
 void clientwin_map(ClientWin *);
+void clientwin_animate(ClientWin *, bool last);
 void clientwin_unmap(ClientWin *);
 int clientwin_handle(ClientWin *, XEvent *);
 int clientwin_cmp_func(dlist *, void*);
+// the client whose client or frame window is wid, in O(1)
+ClientWin *clientwin_find(MainWin *, Window wid);
+// the ClientWin whose mini window is wid, in O(1)
+ClientWin *clientwin_find_mini(MainWin *, Window wid);
 bool clientwin_update(ClientWin *cw);
+void clientwin_update_all(MainWin *mw, dlist *clients);
 bool clientwin_update2(ClientWin *cw);
 bool clientwin_update3(ClientWin *cw);
 bool clientwin_detect_change(ClientWin *cw);
+void clientwin_track(MainWin *mw, const XEvent *ev);
 int clientwin_check_group_leader_func(dlist *l, void *data);
 void clientwin_render(ClientWin *);
-void clientwin_schedule_repair(ClientWin *cw, XRectangle *area);
+void clientwin_schedule_repair(ClientWin *cw, const XRectangle *area);
 void clientwin_repair(ClientWin *cw);
+bool clientwin_snapshot_due(const ClientWin *cw, float scale);
+void clientwin_snapshot(ClientWin *cw, float scale);
+bool clientwin_snapshot_current(const ClientWin *cw);
+void clientwin_live(ClientWin *cw);
 void clientwin_tooltip(ClientWin *cw);
 void childwin_focus(ClientWin *cw);
 
@@ -0,0 +1,125 @@
+/* Skippy-xd
+ *
+ * Copyright (C) 2004 Hyriand <hyriand@thegraveyard.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "skippy.h"
+
+static void
+cwvec_reserve(cwvec_t *v, int capacity) {
+	if (capacity <= v->capacity)
+		return;
+	int newcap = v->capacity ? v->capacity: 16;
+	while (newcap < capacity)
+		newcap *= 2;
+	v->data = srealloc(v->data, newcap, ClientWin *);
+	v->capacity = newcap;
+}
+
+void
+cwvec_push(cwvec_t *v, ClientWin *cw) {
+	cwvec_reserve(v, v->len + 1);
+	v->data[v->len++] = cw;
+}
+
+void
+cwvec_from_dlist(cwvec_t *v, dlist *l) {
+	v->len = 0;
+	for (dlist *iter = dlist_first(l); iter; iter = iter->next)
+		cwvec_push(v, (ClientWin *) iter->data);
+}
+
+void
+cwvec_free(cwvec_t *v) {
+	free(v->data);
+	v->data = NULL;
+	v->len = v->capacity = 0;
+}
+
+int
+cwvec_index_of(const cwvec_t *v, const ClientWin *cw) {
+	for (int i = 0; i < v->len; i++)
+		if (v->data[i] == cw)
+			return i;
+	return -1;
+}
+
+void
+cwvec_remove(cwvec_t *v, int index) {
+	if (index < 0 || index >= v->len)
+		return;
+	memmove(v->data + index, v->data + index + 1,
+			(v->len - index - 1) * sizeof(ClientWin *));
+	v->len--;
+}
+
+static void
+cwvec_reverse_range(ClientWin **a, int from, int to) {
+	for (to--; from < to; from++, to--) {
+		ClientWin *tmp = a[from];
+		a[from] = a[to];
+		a[to] = tmp;
+	}
+}
+
+void
+cwvec_reverse(cwvec_t *v) {
+	cwvec_reverse_range(v->data, 0, v->len);
+}
+
+void
+cwvec_rotate(cwvec_t *v, int n) {
+	if (v->len < 2)
+		return;
+	n %= v->len;
+	if (n < 0)
+		n += v->len;
+	if (!n)
+		return;
+	cwvec_reverse_range(v->data, 0, n);
+	cwvec_reverse_range(v->data, n, v->len);
+	cwvec_reverse_range(v->data, 0, v->len);
+}
+
+void
+cwvec_sort(cwvec_t *v, cwvec_cmp_func cmp, void *data) {
+	int n = v->len;
+	if (n < 2)
+		return;
+
+	// bottom-up, ping-ponging between the data and a scratch buffer
+	ClientWin **src = v->data, **dst = smalloc(n, ClientWin *);
+	ClientWin **scratch = dst;
+	for (int width = 1; width < n; width *= 2) {
+		for (int lo = 0; lo < n; lo += 2 * width) {
+			int mid = MIN(lo + width, n), hi = MIN(lo + 2 * width, n);
+			int i = lo, j = mid, k = lo;
+			while (i < mid && j < hi)
+				dst[k++] = cmp(src[i], src[j], data) > 0 ? src[j++]: src[i++];
+			while (i < mid)
+				dst[k++] = src[i++];
+			while (j < hi)
+				dst[k++] = src[j++];
+		}
+		ClientWin **tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+	if (src != v->data)
+		memcpy(v->data, src, n * sizeof(ClientWin *));
+	free(scratch);
+}
@@ -0,0 +1,67 @@
+/* Skippy-xd
+ *
+ * Copyright (C) 2004 Hyriand <hyriand@thegraveyard.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SKIPPY_CWVEC_H
+#define SKIPPY_CWVEC_H
+
+// growable array of ClientWin pointers, zero-initialized when empty
+
+typedef struct {
+	ClientWin **data;
+	int len, capacity;
+} cwvec_t;
+
+typedef int (*cwvec_cmp_func)(const ClientWin *, const ClientWin *, void *);
+
+// append cw
+void cwvec_push(cwvec_t *v, ClientWin *cw);
+
+// replace the contents with the data of a list, in list order
+void cwvec_from_dlist(cwvec_t *v, dlist *l);
+
+// free the storage (not the ClientWins), leaving an empty vector
+void cwvec_free(cwvec_t *v);
+
+// index of cw, or -1
+int cwvec_index_of(const cwvec_t *v, const ClientWin *cw);
+
+// remove the element at index, keeping the order of the others
+void cwvec_remove(cwvec_t *v, int index);
+
+void cwvec_reverse(cwvec_t *v);
+
+// cycle the elements so that the one at index n (modulo len) comes first
+void cwvec_rotate(cwvec_t *v, int n);
+
+// stable merge sort, elements comparing equal keep their order,
+// data being handed to cmp
+void cwvec_sort(cwvec_t *v, cwvec_cmp_func cmp, void *data);
+
+// element at index, wrapping around in both directions
+static inline ClientWin *
+cwvec_cyclic(const cwvec_t *v, int index) {
+	if (!v->len)
+		return NULL;
+	index %= v->len;
+	if (index < 0)
+		index += v->len;
+	return v->data[index];
+}
+
+#endif /* SKIPPY_CWVEC_H */
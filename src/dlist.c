@@ -573,18 +573,41 @@ dlist_swap(dlist *l1, dlist *l2)
 void
 dlist_sort(dlist *l, dlist_cmp_func cmp, void *data)
 {
-	dlist *start = dlist_first(l);
-	while(start) {
-		dlist *iter = start;
-		start = 0;
-		while(iter) {
-			if(iter->next && cmp(iter, iter->next, data) == 1) {
-				dlist_swap(iter, iter->next);
-				if(! start)
-					start = iter->prev;
-			}
-			iter = iter->next;
+	unsigned int n = dlist_len(l);
+	if (n < 2)
+		return;
+
+	// stable bottom-up merge sort of the elements, the data is then
+	// written back in order so that every element stays in place
+	dlist **src = smalloc(2 * n, dlist *);
+	dlist **dst = src + n, **mem = src;
+	unsigned int k = 0;
+	for (dlist *iter = dlist_first(l); iter; iter = iter->next)
+		src[k++] = iter;
+
+	for (unsigned int width = 1; width < n; width *= 2) {
+		for (unsigned int lo = 0; lo < n; lo += 2 * width) {
+			unsigned int mid = MIN(lo + width, n), hi = MIN(lo + 2 * width, n);
+			unsigned int i = lo, j = mid;
+			k = lo;
+			while (i < mid && j < hi)
+				dst[k++] = cmp(src[i], src[j], data) == 1 ? src[j++]: src[i++];
+			while (i < mid)
+				dst[k++] = src[i++];
+			while (j < hi)
+				dst[k++] = src[j++];
 		}
+		dlist **tmp = src;
+		src = dst;
+		dst = tmp;
 	}
-}
 
+	void **sorted = (void **) dst;
+	for (k = 0; k < n; k++)
+		sorted[k] = src[k]->data;
+	k = 0;
+	for (dlist *iter = dlist_first(l); iter; iter = iter->next)
+		iter->data = sorted[k++];
+
+	free(mem);
+}
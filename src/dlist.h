@@ -117,7 +117,7 @@ dlist *dlist_nth(dlist *l, unsigned int n);
 /* swap the data fields of 2 elements */
 void dlist_swap(dlist *, dlist *);
 
-/* sort a list (not very efficient, uses bubble-sort) */
+/* sort a list (stable merge sort, swaps data) */
 typedef int (*dlist_cmp_func)(dlist *, dlist *, void *);
 void dlist_sort(dlist *, dlist_cmp_func, void *);
 
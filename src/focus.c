@@ -20,7 +20,7 @@
 #include "skippy.h"
 
 typedef float (*dist_func)(SkippyWindow *, SkippyWindow *);
-typedef int (*match_func)(dlist *, SkippyWindow *);
+typedef int (*match_func)(ClientWin *, SkippyWindow *);
 
 /**
  * @brief Focus the mini window of a client window.
@@ -31,24 +31,24 @@ focus_miniw_dir(ClientWin *cw, match_func match, dist_func func) {
 	ClientWin *candidate = NULL;
 	session_t * const ps = cw->mainwin->ps;
 
-	dlist *candidates = dlist_first(dlist_find_all(cw->mainwin->focuslist, (dlist_match_func) match, &cw->mini));
-	if (!candidates) return;
-
-	foreach_dlist (candidates) {
-		ClientWin *win = (ClientWin *) iter->data;
+	cwvec_t *focuslist = &cw->mainwin->focuslist;
+	for (int i = 0; i < focuslist->len; i++) {
+		ClientWin *win = focuslist->data[i];
+		if (!match(win, &cw->mini))
+			continue;
 		float distance = func(&cw->mini, &win->mini);
 		if (!candidate || distance < diff) {
 			candidate = win;
 			diff = distance;
 		}
 	}
+	if (!candidate) return;
 
 	cw->focused = false;
 	clientwin_render(cw);
 	XFlush(ps->dpy);
 
 	focus_miniw(ps, candidate);
-	dlist_free(candidates);
 }
 
 #define HALF_H(w) (w->x + (int)w->width / 2)
@@ -60,8 +60,8 @@ static float name (SkippyWindow *a, SkippyWindow *b) \
 { return sqrt(SQR(d_x) + SQR(d_y)); }
 
 #define QUALFUNC(name, expr) \
-static int name(dlist *l, SkippyWindow *b) \
-{ SkippyWindow *a = &((ClientWin*)l->data)->mini; return expr; }
+static int name(ClientWin *cw, SkippyWindow *b) \
+{ SkippyWindow *a = &cw->mini; return expr; }
 
 #define FOCUSFUNC(name, qual, dist) \
 void name(ClientWin *cw) { focus_miniw_dir(cw, qual, dist); }
@@ -72,15 +72,13 @@ printfdfXFocusChangeEvent(session_t *ps, XFocusChangeEvent *evf, bool print)
 }
 
 static inline void
-clear_focus_all(dlist *focuslist)
+clear_focus_all(cwvec_t *focuslist)
 {
-	dlist *elem = dlist_first(focuslist);
-	while (elem)
+	for (int i = 0; i < focuslist->len; i++)
 	{
-		ClientWin *cw = (ClientWin *)elem->data;
+		ClientWin *cw = focuslist->data[i];
 		if (cw)
 			cw->focused = 0;
-		elem = elem->next;
 	}
 }
 
@@ -122,28 +120,46 @@ focus_miniw(session_t *ps, ClientWin *cw) {
 	focus_miniw_adv(ps, cw, ps->o.moveMouse);
 }
 
+/**
+ * @brief Note the position of each client window in the focus list,
+ * to be done whenever the list changes.
+ */
+static inline void
+focuslist_reindex(cwvec_t *focuslist) {
+	for (int i = 0; i < focuslist->len; i++)
+		focuslist->data[i]->focus_index = i;
+}
+
+/**
+ * @brief Position of a client window in the focus list, or -1.
+ */
+static inline int
+focuslist_index_of(const cwvec_t *focuslist, const ClientWin *cw) {
+	int i = cw->focus_index;
+	if (i >= 0 && i < focuslist->len && focuslist->data[i] == cw)
+		return i;
+	return -1;
+}
+
 /**
  * @brief Focus the mini window of next client window in list.
  */
 static inline void
 focus_miniw_next(session_t *ps, ClientWin *cw) {
-	dlist *e = dlist_find_data(cw->mainwin->focuslist, cw);
-	if (!e) {
+	cwvec_t *focuslist = &cw->mainwin->focuslist;
+	int i = focuslist_index_of(focuslist, cw);
+	if (i < 0) {
 		printfef(false, "() (%#010lx): Client window not found in list.", cw->src.window);
 		return;
 	}
 
-	if (e->next)
-		e = e->next;
-	else
-		e = dlist_first(e);
-
-	if (e->data != cw) {
+	ClientWin *tgt = cwvec_cyclic(focuslist, i + 1);
+	if (tgt != cw) {
 		/* Set the new selection first so repaints consider the new
 		 * client_to_focus, then clear and repaint the old one. This
 		 * prevents the previous window from being considered selected
 		 * during its repaint. */
-		focus_miniw(ps, e->data);
+		focus_miniw(ps, tgt);
 		cw->focused = false;
 		clientwin_render(cw);
 	}
@@ -154,26 +170,15 @@ focus_miniw_next(session_t *ps, ClientWin *cw) {
  */
 static inline void
 focus_miniw_prev(session_t *ps, ClientWin *cw) {
-	dlist *cwlist = dlist_first(cw->mainwin->focuslist);
-	dlist *tgt = NULL;
-
-	if (cw == cwlist->data)
-		tgt = dlist_last(cwlist);
-	else
-		foreach_dlist (cwlist) {
-			if (iter->next && cw == iter->next->data) {
-				tgt = iter;
-				break;
-			}
-		}
-
-	if (!tgt) {
+	cwvec_t *focuslist = &cw->mainwin->focuslist;
+	int i = focuslist_index_of(focuslist, cw);
+	if (i < 0) {
 		printfef(false, "() (%#010lx): Client window not found in list.", cw->src.window);
 		return;
 	}
 
 	/* Activate the new selection first, then clear/repaint the previous. */
-	focus_miniw(ps, (ClientWin *) tgt->data);
+	focus_miniw(ps, cwvec_cyclic(focuslist, i - 1));
 	cw->focused = false;
 	clientwin_render(cw);
 }
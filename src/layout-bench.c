@@ -0,0 +1,507 @@
+/* Skippy-xd
+ *
+ * Copyright (C) 2004 Hyriand <hyriand@thegraveyard.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Standalone benchmark of the layout algorithms on synthetic window sets,
+// needing no X connection. Exits with a non-zero status should a layout
+// come out with overlapping windows, or should cosmos lay out windows
+// differently without its broadphase grid and vector kernels, or should
+// a warm started cosmos run on unchanged windows not reproduce the cold
+// one, or should one with a window resized overlap or take over twice as
+// long as the cold one, or should the daemon's path through
+// layout_job_start() and the layout cache come up with another layout
+// than the algorithm called directly.
+
+#include "skippy.h"
+#include <getopt.h>
+
+bool debuglog = false;
+session_t *ps_g = NULL;
+
+// every window sits on the current desktop
+long
+wm_get_current_desktop(session_t *ps) {
+	return 0;
+}
+
+long
+wm_get_window_desktop(session_t *ps, Window wid) {
+	return 0;
+}
+
+unsigned long
+wm_get_desktops(session_t *ps) {
+	return 1;
+}
+
+#define BENCH_SCREEN_WIDTH 1920
+#define BENCH_SCREEN_HEIGHT 1080
+#define BENCH_DISTANCE 50
+// cosmos is run again without the broadphase grid and the vector kernels
+// up to this many windows
+#define BENCH_DIRECT_MAX 200
+// a warm run with a window resized may take up to this many times as long
+// as the cold run, below BENCH_WARM_MIN_USEC it is too short to tell
+#define BENCH_WARM_MAX_RATIO 2
+#define BENCH_WARM_MIN_USEC 1000
+#define BENCH_WARM_RUNS 3
+// most windows cosmos lays out by default without a time budget,
+// 500 windows already taking most of a minute
+#define BENCH_COSMOS_MAX 200
+
+static const int bench_sizes[] = { 5, 10, 20, 50, 100, 200, 500, 1000, 2000 };
+
+enum benchset {
+	BENCHSET_RANDOM,
+	BENCHSET_TILED,
+	BENCHSET_CASCADED,
+	BENCHSET_IDENTICAL,
+	BENCHSET_MIXED,
+	NUM_BENCHSET,
+};
+
+static const char * const bench_set_names[NUM_BENCHSET] = {
+	"random",
+	"tiled",
+	"cascaded",
+	"identical",
+	"mixed",
+};
+
+// own generator, so that numbers do not depend on the libc
+static unsigned long bench_seed;
+
+static int
+bench_rand(int n) {
+	bench_seed = bench_seed * 6364136223846793005UL + 1442695040888963407UL;
+	return (int) ((bench_seed >> 33) % (unsigned long) n);
+}
+
+static void
+bench_window(ClientWin *cw, MainWin *mw, int i, int x, int y, int w, int h) {
+	memset(cw, 0, sizeof(*cw));
+	cw->mainwin = mw;
+	cw->mode = CLIDISP_FILLED;
+	cw->src.window = cw->wid_client = 0x1000 + i;
+	cw->src.x = cw->x = x;
+	cw->src.y = cw->y = y;
+	cw->src.width = w;
+	cw->src.height = h;
+}
+
+static void
+bench_generate(ClientWin *cws, MainWin *mw, enum benchset set, int n) {
+	int sw = BENCH_SCREEN_WIDTH, sh = BENCH_SCREEN_HEIGHT;
+	int cols = ceil(sqrt(n));
+	int rows = (n + cols - 1) / cols;
+
+	bench_seed = 12345;
+	for (int i = 0; i < n; i++) {
+		int w, h, x, y;
+		switch (set) {
+			case BENCHSET_RANDOM:
+				w = 200 + bench_rand(1000);
+				h = 150 + bench_rand(650);
+				// one draw per statement, arguments are evaluated
+				// in no particular order
+				x = bench_rand(sw - w);
+				y = bench_rand(sh - h);
+				bench_window(&cws[i], mw, i, x, y, w, h);
+				break;
+			case BENCHSET_TILED:
+				w = sw / cols;
+				h = sh / rows;
+				bench_window(&cws[i], mw, i, i % cols * w, i / cols * h, w, h);
+				break;
+			case BENCHSET_CASCADED:
+				bench_window(&cws[i], mw, i, i * 30 % (sw - 800),
+						i * 30 % (sh - 600), 800, 600);
+				break;
+			case BENCHSET_IDENTICAL:
+				bench_window(&cws[i], mw, i, 100, 100, 800, 600);
+				break;
+			case BENCHSET_MIXED:
+			default:
+				switch (i % 5) {
+					case 0: w = 1280; h = 720; break;
+					case 1: w = 450; h = 800; break;
+					case 2: w = 1600; h = 120; break;
+					case 3: w = 150; h = 150; break;
+					default: w = 600; h = 600; break;
+				}
+				x = bench_rand(sw - w);
+				y = bench_rand(sh - h);
+				bench_window(&cws[i], mw, i, x, y, w, h);
+				break;
+		}
+	}
+}
+
+static long
+bench_usec(void) {
+	struct timeval tp;
+	gettimeofday(&tp, NULL);
+	return tp.tv_sec * 1000000L + tp.tv_usec;
+}
+
+static int
+bench_overlaps(const layout_ws_t *ws) {
+	int count = 0;
+	for (int i = 0; i < ws->n; i++) {
+		for (int j = i + 1; j < ws->n; j++) {
+			if (MIN(ws->x[i] + ws->width[i], ws->x[j] + ws->width[j]) > MAX(ws->x[i], ws->x[j])
+					&& MIN(ws->y[i] + ws->height[i], ws->y[j] + ws->height[j]) > MAX(ws->y[i], ws->y[j]))
+				count++;
+		}
+	}
+	return count;
+}
+
+// cosmos once more without the grid, the vector kernels nor a time budget,
+// false should the layout differ
+static bool
+bench_direct(MainWin *mw, dlist *windows, const layout_ws_t *ref, long *elapsed) {
+	int budget = mw->ps->o.cosmosTimeBudget;
+	mw->ps->o.cosmosTimeBudget = 0;
+	layout_ws_t ws;
+	layout_ws_init(&ws, mw, windows);
+	ws.direct = true;
+	ws.scalar = true;
+	long start = bench_usec();
+	layout_cosmos(mw, &ws);
+	*elapsed = bench_usec() - start;
+	mw->ps->o.cosmosTimeBudget = budget;
+
+	bool same = ws.total_width == ref->total_width
+		&& ws.total_height == ref->total_height;
+	for (int i = 0; same && i < ws.n; i++)
+		same = ws.x[i] == ref->x[i] && ws.y[i] == ref->y[i];
+	layout_ws_free(&ws);
+	return same;
+}
+
+// cosmos again from the warm table of the reference run, on the same windows
+// and with one of them resized; false should the unchanged windows not come
+// out where the reference run left them, and *resized_ok false should the
+// run with a window resized overlap or be much slower than the cold one
+static bool
+bench_warm(MainWin *mw, dlist *windows, layout_ws_t *ref, long elapsed_cold,
+		long *elapsed, long *elapsed_resized, bool *resized_ok) {
+	layout_warm_t *warm = NULL;
+	layout_warm_update(&warm, ref);
+
+	layout_ws_t ws;
+	layout_ws_init(&ws, mw, windows);
+	ws.warm = warm;
+	long start = bench_usec();
+	bool same = layout_cosmos(mw, &ws);
+	*elapsed = bench_usec() - start;
+
+	same = same && ws.npinned == ws.n
+		&& ws.total_width == ref->total_width
+		&& ws.total_height == ref->total_height;
+	for (int i = 0; same && i < ws.n; i++)
+		same = ws.x[i] == ref->x[i] && ws.y[i] == ref->y[i];
+	layout_ws_free(&ws);
+
+	// the fastest of a few runs, should one be preempted
+	*elapsed_resized = LONG_MAX;
+	for (int k = 0; k < BENCH_WARM_RUNS; k++) {
+		layout_ws_init(&ws, mw, windows);
+		ws.warm = warm;
+		ws.width[0] += BENCH_DISTANCE;
+		start = bench_usec();
+		bool laid_out = layout_cosmos(mw, &ws);
+		*elapsed_resized = MIN(*elapsed_resized, bench_usec() - start);
+		bool overlaps = laid_out && bench_overlaps(&ws);
+		layout_ws_free(&ws);
+
+		*resized_ok = !overlaps
+			&& (*elapsed_resized <= BENCH_WARM_MAX_RATIO * elapsed_cold
+					|| *elapsed_resized < BENCH_WARM_MIN_USEC);
+		if (*resized_ok || overlaps)
+			break;
+	}
+
+	layout_warm_free(warm);
+	return same;
+}
+
+// the daemon's path: layout_job_start() on a worker thread, then
+// layout_run(), which the layout cache must answer with the job's layout;
+// false should that differ, or should the job's layout differ from the
+// reference one. A time budget may let the latter happen, so they are only
+// compared without one, and a layout it cut short is not cached.
+static bool
+bench_job(MainWin *mw, dlist *windows, const layout_ws_t *ref,
+		long *elapsed, long *elapsed_cached) {
+	unsigned int width = 0, height = 0;
+	bool compare = !mw->ps->o.cosmosTimeBudget;
+
+	// as on the first activation
+	layout_cache_free(mw->layout_cache);
+	mw->layout_cache = NULL;
+	layout_warm_free(mw->cosmos_warm);
+	mw->cosmos_warm = NULL;
+
+	long start = bench_usec();
+	layout_job_finish(layout_job_start(mw, windows, true), &width, &height);
+	*elapsed = bench_usec() - start;
+
+	bool same = width == ref->total_width && height == ref->total_height;
+	for (int i = 0; same && i < ref->n; i++)
+		same = ref->cw[i]->x == ref->x[i] && ref->cw[i]->y == ref->y[i];
+
+	unsigned int job_width = width, job_height = height;
+	int *job_x = smalloc(MAX(ref->n, 1), int), *job_y = smalloc(MAX(ref->n, 1), int);
+	for (int i = 0; i < ref->n; i++) {
+		job_x[i] = ref->cw[i]->x;
+		job_y[i] = ref->cw[i]->y;
+	}
+
+	unsigned long hits = mw->layout_cache->hits;
+	width = height = 0;
+	start = bench_usec();
+	layout_run(mw, windows, &width, &height, LAYOUTMODE_EXPOSE);
+	*elapsed_cached = bench_usec() - start;
+
+	bool hit = mw->layout_cache->hits == hits + 1;
+	bool cached = hit && width == job_width && height == job_height;
+	for (int i = 0; cached && i < ref->n; i++)
+		cached = ref->cw[i]->x == job_x[i] && ref->cw[i]->y == job_y[i];
+	free(job_x);
+	free(job_y);
+
+	if (!compare)
+		return cached || !hit;
+	return cached && same;
+}
+
+// lay out one set, returning whether it failed
+static bool
+bench_run(MainWin *mw, int algorithm, enum benchset set, int n) {
+	ClientWin *cws = scalloc(n, ClientWin);
+	bench_generate(cws, mw, set, n);
+
+	dlist *clients = NULL;
+	for (int i = 0; i < n; i++)
+		clients = dlist_add(clients, &cws[i]);
+	clients = dlist_first(clients);
+	// the window order layout_job_start() hands to each algorithm
+	dlist *windows = dlist_dup(clients);
+	if (algorithm == LAYOUT_COSMOS) {
+		dlist_sort(windows, sort_cw_by_id, 0);
+		dlist_sort(windows, sort_cw_by_row, 0);
+	}
+	else
+		dlist_reverse(windows);
+
+	layout_ws_t ws;
+	layout_ws_init(&ws, mw, windows);
+	// what cosmos returned: its own layout, the best one
+	// when out of time, or none and xd took over
+	const char *out = "-";
+	long start = bench_usec();
+	if (algorithm == LAYOUT_XD)
+		layout_xd(mw, &ws);
+	else if (!layout_cosmos(mw, &ws)) {
+		// as layout_run() would do
+		layout_ws_free(&ws);
+		layout_ws_init(&ws, mw, windows);
+		layout_xd(mw, &ws);
+		out = "xd";
+	}
+	else if (ws.timed_out)
+		out = "best";
+	long elapsed = bench_usec() - start;
+
+	double area = 0;
+	for (int i = 0; i < n; i++)
+		area += (double) ws.width[i] * ws.height[i];
+	double total = (double) ws.total_width * ws.total_height;
+	float multiplier = MIN(
+			(float) (mw->width - 2 * mw->distance) / ws.total_width,
+			(float) (mw->height - 2 * mw->distance) / ws.total_height);
+	int overlaps = bench_overlaps(&ws);
+	bool failed = overlaps > 0;
+
+	char direct[16] = "-";
+	if (algorithm == LAYOUT_COSMOS && !strcmp(out, "-")
+			&& n <= BENCH_DIRECT_MAX) {
+		long direct_elapsed;
+		if (bench_direct(mw, windows, &ws, &direct_elapsed))
+			snprintf(direct, sizeof(direct), "%.3f", direct_elapsed / 1000.0);
+		else {
+			strcpy(direct, "differs");
+			failed = true;
+		}
+	}
+
+	// needs the warm entries, which only a finished layout has
+	char warm[16] = "-", warm_resized[16] = "-";
+	if (algorithm == LAYOUT_COSMOS && !strcmp(out, "-")) {
+		long warm_elapsed, resized_elapsed;
+		bool resized_ok;
+		if (bench_warm(mw, windows, &ws, elapsed,
+					&warm_elapsed, &resized_elapsed, &resized_ok))
+			snprintf(warm, sizeof(warm), "%.3f", warm_elapsed / 1000.0);
+		else {
+			strcpy(warm, "differs");
+			failed = true;
+		}
+		if (resized_ok)
+			snprintf(warm_resized, sizeof(warm_resized), "%.3f",
+					resized_elapsed / 1000.0);
+		else {
+			snprintf(warm_resized, sizeof(warm_resized), "!%.3f",
+					resized_elapsed / 1000.0);
+			failed = true;
+		}
+	}
+
+	// last, as it moves the windows
+	char job[16], cached[16];
+	{
+		long job_elapsed, cached_elapsed;
+		bool same = bench_job(mw, clients, &ws, &job_elapsed, &cached_elapsed);
+		snprintf(job, sizeof(job), "%.3f", job_elapsed / 1000.0);
+		if (same)
+			snprintf(cached, sizeof(cached), "%.3f", cached_elapsed / 1000.0);
+		else {
+			strcpy(cached, "differs");
+			failed = true;
+		}
+	}
+
+	printf("%-6s %-9s %5d %10.3f %4s %10s %10s %10s %10s %10s %5d %5d %5d %5d %9.4f %7.3f %6d\n",
+			algorithm == LAYOUT_COSMOS ? "cosmos" : "xd",
+			bench_set_names[set], n, elapsed / 1000.0, out, direct,
+			warm, warm_resized, job, cached,
+			ws.scatter_iterations, ws.expansion_iterations, ws.collapse_iterations,
+			ws.separate_iterations,
+			multiplier, total > 0 ? 1.0 - area / total : 0.0, overlaps);
+	fflush(stdout);
+
+	layout_ws_free(&ws);
+	dlist_free(windows);
+	dlist_free(clients);
+	free(cws);
+	return failed;
+}
+
+static void
+bench_usage(const char *name) {
+	printf("usage: %s [-a xd|cosmos] [-s set] [-n max_windows]\n"
+			"       [-b cosmos_time_budget_ms] [-t cosmos_opening_angle] [-v]\n"
+			"sets: random, tiled, cascaded, identical, mixed\n"
+			"the cosmos time budget defaults to the daemon's, %d ms, 0 is none;\n"
+			"without one, cosmos stops at %d windows unless -n is given\n",
+			name, ((session_t) SESSIONT_INIT).o.cosmosTimeBudget,
+			BENCH_COSMOS_MAX);
+}
+
+int
+main(int argc, char **argv) {
+	int max_windows = -1;
+	int only_algorithm = -1, only_set = -1;
+	// the daemon's defaults, cosmos time budget included
+	static session_t ps = SESSIONT_INIT;
+	static MainWin mw;
+
+	ps.o.mode = PROGMODE_EXPOSE;
+
+	int o;
+	while ((o = getopt(argc, argv, "a:s:n:b:t:vh")) >= 0) {
+		switch (o) {
+			case 'a':
+				if (!strcmp(optarg, "xd"))
+					only_algorithm = LAYOUT_XD;
+				else if (!strcmp(optarg, "cosmos"))
+					only_algorithm = LAYOUT_COSMOS;
+				else {
+					bench_usage(argv[0]);
+					return 2;
+				}
+				break;
+			case 's':
+				for (int set = 0; set < NUM_BENCHSET; set++)
+					if (!strcmp(optarg, bench_set_names[set]))
+						only_set = set;
+				if (only_set < 0) {
+					bench_usage(argv[0]);
+					return 2;
+				}
+				break;
+			case 'n':
+				max_windows = atoi(optarg);
+				break;
+			case 'b':
+				ps.o.cosmosTimeBudget = atoi(optarg);
+				break;
+			case 't':
+				ps.o.cosmosOpeningAngle = atof(optarg);
+				break;
+			case 'v':
+				debuglog = true;
+				break;
+			default:
+				bench_usage(argv[0]);
+				return o == 'h' ? 0 : 2;
+		}
+	}
+
+	mw.ps = &ps;
+	mw.width = BENCH_SCREEN_WIDTH;
+	mw.height = BENCH_SCREEN_HEIGHT;
+	mw.distance = BENCH_DISTANCE;
+
+	printf("%-6s %-9s %5s %10s %4s %10s %10s %10s %10s %10s %5s %5s %5s %5s %9s %7s %6s\n",
+			"layout", "set", "n", "ms", "out", "direct", "warm", "resized",
+			"job", "cached",
+			"scat", "expa", "coll", "sepa",
+			"scale", "wasted", "overl");
+
+	int failures = 0;
+	const int algorithms[] = { LAYOUT_XD, LAYOUT_COSMOS };
+	for (int a = 0; a < 2; a++) {
+		if (only_algorithm >= 0 && algorithms[a] != only_algorithm)
+			continue;
+		ps.o.exposeLayout = algorithms[a];
+		int max = max_windows;
+		if (max < 0)
+			max = algorithms[a] == LAYOUT_COSMOS && !ps.o.cosmosTimeBudget ?
+				BENCH_COSMOS_MAX: INT_MAX;
+		for (int set = 0; set < NUM_BENCHSET; set++) {
+			if (only_set >= 0 && set != only_set)
+				continue;
+			for (int k = 0; k < sizeof(bench_sizes) / sizeof(bench_sizes[0]); k++) {
+				if (bench_sizes[k] > max)
+					break;
+				if (bench_run(&mw, algorithms[a], set, bench_sizes[k]))
+					failures++;
+			}
+		}
+	}
+
+	layout_cache_free(mw.layout_cache);
+	layout_warm_free(mw.cosmos_warm);
+
+	if (failures)
+		printf("%d layouts failed\n", failures);
+	return failures ? 1 : 0;
+}
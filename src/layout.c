@@ -19,38 +19,348 @@
 
 #include "skippy.h"
 
-// this function redirects to different functions
-// which performs the expose layout
-// by calaculating cw->x, cw->y (new coordinates)
-// and total_width, total_height
-// given cw->src.x, cw->src.y (original coordinates)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COSMOS_SIMD
+#include <immintrin.h>
+#endif
+
+void
+layout_ws_init(layout_ws_t *ws, MainWin *mw, dlist *windows)
+{
+	int n = dlist_len(windows);
+	int size = MAX(n, 1);
+
+	ws->n = n;
+	ws->cw = smalloc(size, ClientWin *);
+	ws->wid = smalloc(size, Window);
+	ws->width = smalloc(size, int);
+	ws->height = smalloc(size, int);
+	ws->x = smalloc(size, int);
+	ws->y = smalloc(size, int);
+	ws->hidden = smalloc(size, bool);
+	ws->fx = scalloc(size, float);
+	ws->fy = scalloc(size, float);
+	ws->fx2 = scalloc(size, float);
+	ws->fy2 = scalloc(size, float);
+	ws->vx = scalloc(size, float);
+	ws->vy = scalloc(size, float);
+	ws->mass = scalloc(size, float);
+	ws->cx = scalloc(size, float);
+	ws->cy = scalloc(size, float);
+	ws->pw = scalloc(size, float);
+	ws->ph = scalloc(size, float);
+	ws->pinned = scalloc(size, bool);
+	ws->warm = NULL;
+	ws->warm_entries = NULL;
+	ws->npinned = 0;
+	ws->warm_removed = false;
+	// every run scatters windows the same way
+	ws->seed = 0;
+
+	int i = 0;
+	foreach_dlist (dlist_first(windows)) {
+		ClientWin *cw = iter->data;
+		ws->cw[i] = cw;
+		ws->wid[i] = cw->src.window;
+		ws->width[i] = cw->src.width;
+		ws->height[i] = cw->src.height;
+		ws->x[i] = cw->x;
+		ws->y[i] = cw->y;
+		ws->hidden[i] = !cw->mode;
+		i++;
+	}
+
+	ws->distance = mw->distance;
+	ws->screen_width = mw->width;
+	ws->screen_height = mw->height;
+	ws->one_row = mw->ps->o.layoutOneRow;
+	ws->one_row_items = mw->ps->o.layoutOneRowItems;
+	ws->time_budget = mw->ps->o.cosmosTimeBudget;
+	ws->opening_angle = mw->ps->o.cosmosOpeningAngle;
+	ws->total_width = ws->total_height = 0;
+	ws->direct = false;
+	ws->scalar = false;
+	ws->timed_out = false;
+	ws->scatter_iterations = ws->expansion_iterations = ws->collapse_iterations = 0;
+	ws->separate_iterations = 0;
+}
+
+void
+layout_ws_apply(layout_ws_t *ws)
+{
+	for (int i = 0; i < ws->n; i++) {
+		ws->cw[i]->x = ws->x[i];
+		ws->cw[i]->y = ws->y[i];
+	}
+}
+
+void
+layout_ws_free(layout_ws_t *ws)
+{
+	free(ws->cw);
+	free(ws->wid);
+	free(ws->width);
+	free(ws->height);
+	free(ws->x);
+	free(ws->y);
+	free(ws->hidden);
+	free(ws->fx);
+	free(ws->fy);
+	free(ws->fx2);
+	free(ws->fy2);
+	free(ws->vx);
+	free(ws->vy);
+	free(ws->mass);
+	free(ws->cx);
+	free(ws->cy);
+	free(ws->pw);
+	free(ws->ph);
+	free(ws->pinned);
+	free(ws->warm_entries);
+	memset(ws, 0, sizeof(*ws));
+}
+
+void
+layout_warm_free(layout_warm_t *warm)
+{
+	if (!warm)
+		return;
+	free(warm->entries);
+	free(warm);
+}
+
+void
+layout_warm_update(layout_warm_t **warm, layout_ws_t *ws)
+{
+	if (!ws->warm_entries)
+		return;
+	if (!*warm)
+		*warm = scalloc(1, layout_warm_t);
+
+	free((*warm)->entries);
+	(*warm)->entries = ws->warm_entries;
+	(*warm)->n = ws->n;
+	(*warm)->distance = ws->distance;
+	(*warm)->screen_width = ws->screen_width;
+	(*warm)->screen_height = ws->screen_height;
+	ws->warm_entries = NULL;
+}
+
+static inline uint64_t
+layout_hash(uint64_t h, const void *data, size_t len) {
+	const unsigned char *p = data;
+	for (size_t i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+static int
+layout_key_cmp_wid(const void *a, const void *b) {
+	Window wa = ((const layout_key_window_t *) a)->wid;
+	Window wb = ((const layout_key_window_t *) b)->wid;
+	return (wa > wb) - (wa < wb);
+}
+
+// describe the windows on the given desktop for the cache,
+// cws receiving them in the order of the key
+static void
+layout_cache_key_init(layout_cache_key_t *key, MainWin *mw, dlist *windows,
+		long desktop, bool cosmos, ClientWin **cws) {
+	session_t *ps = mw->ps;
+	int n = dlist_len(windows);
+
+	memset(key, 0, sizeof(*key));
+	key->mode = ps->o.mode;
+	key->algorithm = cosmos ? LAYOUT_COSMOS : LAYOUT_XD;
+	key->screen_width = mw->width;
+	key->screen_height = mw->height;
+	key->distance = mw->distance;
+	key->desktop = desktop;
+	key->one_row = ps->o.layoutOneRow;
+	key->one_row_items = ps->o.layoutOneRowItems;
+	key->n = n;
+	// zeroed, so that padding never tells two keys apart
+	key->windows = scalloc(MAX(n, 1), layout_key_window_t);
+
+	int i = 0;
+	foreach_dlist (dlist_first(windows)) {
+		ClientWin *cw = iter->data;
+		layout_key_window_t *kw = &key->windows[i];
+		kw->wid = cw->src.window;
+		kw->x = cw->src.x;
+		kw->y = cw->src.y;
+		kw->width = cw->src.width;
+		kw->height = cw->src.height;
+		// cosmos sorts the windows itself
+		kw->rank = cosmos ? 0 : i;
+		kw->hidden = !cw->mode;
+		i++;
+	}
+	qsort(key->windows, n, sizeof(*key->windows), layout_key_cmp_wid);
+
+	// window ids are unique, a binary search finds each window's slot
+	foreach_dlist (dlist_first(windows)) {
+		ClientWin *cw = iter->data;
+		layout_key_window_t kw = { .wid = cw->src.window };
+		layout_key_window_t *found = bsearch(&kw, key->windows, n,
+				sizeof(kw), layout_key_cmp_wid);
+		cws[found - key->windows] = cw;
+	}
+
+	uint64_t h = 14695981039346656037ULL;
+	h = layout_hash(h, &key->mode, sizeof(key->mode));
+	h = layout_hash(h, &key->algorithm, sizeof(key->algorithm));
+	h = layout_hash(h, &key->screen_width, sizeof(key->screen_width));
+	h = layout_hash(h, &key->screen_height, sizeof(key->screen_height));
+	h = layout_hash(h, &key->distance, sizeof(key->distance));
+	h = layout_hash(h, &key->desktop, sizeof(key->desktop));
+	h = layout_hash(h, &key->one_row, sizeof(key->one_row));
+	h = layout_hash(h, &key->one_row_items, sizeof(key->one_row_items));
+	h = layout_hash(h, key->windows, n * sizeof(*key->windows));
+	key->hash = h;
+}
+
+static bool
+layout_cache_key_equal(const layout_cache_key_t *a, const layout_cache_key_t *b) {
+	return a->hash == b->hash
+		&& a->mode == b->mode
+		&& a->algorithm == b->algorithm
+		&& a->screen_width == b->screen_width
+		&& a->screen_height == b->screen_height
+		&& a->distance == b->distance
+		&& a->desktop == b->desktop
+		&& a->one_row == b->one_row
+		&& a->one_row_items == b->one_row_items
+		&& a->n == b->n
+		&& !memcmp(a->windows, b->windows, a->n * sizeof(*a->windows));
+}
+
+static void
+layout_cache_entry_free(layout_cache_entry_t *entry) {
+	free(entry->key.windows);
+	free(entry->x);
+	free(entry->y);
+	memset(entry, 0, sizeof(*entry));
+}
+
+// apply a cached layout, if any, to the windows of the key
+static bool
+layout_cache_lookup(layout_cache_t *cache, const layout_cache_key_t *key,
+		ClientWin **cws, unsigned int *total_width, unsigned int *total_height) {
+	for (int e = 0; e < LAYOUT_CACHE_SIZE; e++) {
+		layout_cache_entry_t *entry = &cache->entries[e];
+		if (!entry->key.windows || !layout_cache_key_equal(&entry->key, key))
+			continue;
+
+		for (int i = 0; i < key->n; i++) {
+			cws[i]->x = entry->x[i];
+			cws[i]->y = entry->y[i];
+		}
+		*total_width = entry->total_width;
+		*total_height = entry->total_height;
+		entry->stamp = ++cache->clock;
+		cache->hits++;
+		return true;
+	}
+	cache->misses++;
+	return false;
+}
+
+// keep the layout of the windows, taking over the key
+static void
+layout_cache_store(layout_cache_t *cache, layout_cache_key_t *key,
+		ClientWin **cws, unsigned int total_width, unsigned int total_height) {
+	layout_cache_entry_t *entry = &cache->entries[0];
+	for (int e = 1; e < LAYOUT_CACHE_SIZE && entry->key.windows; e++) {
+		if (!cache->entries[e].key.windows
+				|| cache->entries[e].stamp < entry->stamp)
+			entry = &cache->entries[e];
+	}
+	layout_cache_entry_free(entry);
+
+	entry->key = *key;
+	entry->x = smalloc(MAX(key->n, 1), int);
+	entry->y = smalloc(MAX(key->n, 1), int);
+	for (int i = 0; i < key->n; i++) {
+		entry->x[i] = cws[i]->x;
+		entry->y[i] = cws[i]->y;
+	}
+	entry->total_width = total_width;
+	entry->total_height = total_height;
+	entry->stamp = ++cache->clock;
+}
+
+void
+layout_cache_free(layout_cache_t *cache)
+{
+	if (!cache)
+		return;
+	for (int e = 0; e < LAYOUT_CACHE_SIZE; e++)
+		layout_cache_entry_free(&cache->entries[e]);
+	free(cache);
+}
+
+static void
+layout_cosmos_report(const layout_ws_t *ws) {
+	printfdf(false, "(): %d of %d windows warm started%s", ws->npinned, ws->n,
+			ws->warm_removed ? ", some removed" : "");
+	printfdf(false, "(): %d iterations to resolve identical COM, "
+			"%d expansion iterations, %d collapse iterations, "
+			"%d separation iterations",
+			ws->scatter_iterations, ws->expansion_iterations,
+			ws->collapse_iterations, ws->separate_iterations);
+	if (ws->timed_out)
+		printfdf(false, "(): time budget of %d ms exceeded", ws->time_budget);
+}
+
+static void *
+layout_job_compute(void *data) {
+	layout_job_t *job = data;
+
+	if (job->cosmos && layout_cosmos(job->mw, &job->cosmos_ws))
+		job->result = &job->cosmos_ws;
+	if (!job->result && job->xd) {
+		layout_xd(job->mw, &job->xd_ws);
+		job->result = &job->xd_ws;
+	}
+
+	return NULL;
+}
+
+layout_job_t *
+layout_job_start(MainWin *mw, dlist *windows, bool threaded) {
+	layout_job_t *job = scalloc(1, layout_job_t);
+	job->mw = mw;
+
+	bool cosmos = (mw->ps->o.mode == PROGMODE_EXPOSE && mw->ps->o.exposeLayout == LAYOUT_COSMOS)
+		|| (mw->ps->o.mode == PROGMODE_SWITCH && mw->ps->o.switchLayout == LAYOUT_COSMOS);
+
+	// the same for every window of the job
+	int current_desktop = wm_get_current_desktop(mw->ps);
+
+	if (cosmos) {
+		int screencount = wm_get_desktops(mw->ps);
+		if (screencount == -1)
+			screencount = 1;
+		int desktop_dim = ceil(sqrt(screencount));
+
+		int current_desktop_x = current_desktop % desktop_dim;
+		int current_desktop_y = current_desktop / desktop_dim;
 
-void layout_run(MainWin *mw, dlist *windows,
-		unsigned int *total_width, unsigned int *total_height,
-		enum layoutmode layout) {
-	if ((mw->ps->o.mode == PROGMODE_EXPOSE && mw->ps->o.exposeLayout == LAYOUT_COSMOS)
-	|| (mw->ps->o.mode == PROGMODE_SWITCH && mw->ps->o.switchLayout == LAYOUT_COSMOS)) {
 		foreach_dlist (dlist_first(windows)) {
 			ClientWin *cw = iter->data;
 
 			// virtual desktop offset
 			{
-				int screencount = wm_get_desktops(mw->ps);
-				if (screencount == -1)
-					screencount = 1;
-				int desktop_dim = ceil(sqrt(screencount));
-
 				int win_desktop = wm_get_window_desktop(mw->ps, cw->wid_client);
-				int current_desktop = wm_get_current_desktop(mw->ps);
 				if (win_desktop == -1)
 					win_desktop = current_desktop;
 
 				int win_desktop_x = win_desktop % desktop_dim;
 				int win_desktop_y = win_desktop / desktop_dim;
 
-				int current_desktop_x = current_desktop % desktop_dim;
-				int current_desktop_y = current_desktop / desktop_dim;
-
 				cw->src.x += (win_desktop_x - current_desktop_x) * (mw->width + mw->distance);
 				cw->src.y += (win_desktop_y - current_desktop_y) * (mw->height + mw->distance);
 			}
@@ -58,169 +368,263 @@ void layout_run(MainWin *mw, dlist *windows,
 			cw->x = cw->src.x;
 			cw->y = cw->src.y;
 		}
+	}
+
+	// toggling expose without touching anything, or flipping
+	// between desktops, brings up the same window sets again
+	if (!mw->layout_cache)
+		mw->layout_cache = scalloc(1, layout_cache_t);
+	job->cache = mw->layout_cache;
+	job->cws = smalloc(MAX(dlist_len(windows), 1), ClientWin *);
+	layout_cache_key_init(&job->key, mw, windows, current_desktop,
+			cosmos, job->cws);
+	if (layout_cache_lookup(job->cache, &job->key, job->cws,
+				&job->total_width, &job->total_height)) {
+		printfdf(false, "(): layout cache hit, %lu hits %lu misses",
+				job->cache->hits, job->cache->misses);
+		job->cached = true;
+		return job;
+	}
+	printfdf(false, "(): layout cache miss, %lu hits %lu misses",
+			job->cache->hits, job->cache->misses);
 
+	// the workspaces are the snapshot the computation runs on,
+	// it touches neither the windows nor the X connection
+	if (cosmos && mw->ps->o.exposeLayout == LAYOUT_COSMOS) {
 		dlist *sorted_windows = dlist_dup(windows);
 		dlist_sort(sorted_windows, sort_cw_by_id, 0);
 		dlist_sort(sorted_windows, sort_cw_by_row, 0);
-		if (mw->ps->o.exposeLayout == LAYOUT_COSMOS)
-			layout_cosmos(mw, sorted_windows, total_width, total_height);
+		layout_ws_init(&job->cosmos_ws, mw, sorted_windows);
+		// only read by the worker, replaced once the job is finished
+		job->cosmos_ws.warm = mw->cosmos_warm;
+		job->cosmos = true;
 		dlist_free(sorted_windows);
 	}
-	else {
+	// xd is also the fallback of a cosmos layout running out of time
+	if (!cosmos || (job->cosmos && job->cosmos_ws.time_budget > 0)) {
 		// to get the proper z-order based window ordering,
 		// reversing the list of windows is needed
 		dlist_reverse(windows);
-		layout_xd(mw, windows, total_width, total_height);
+		layout_ws_init(&job->xd_ws, mw, windows);
 		// reversing the linked list again for proper focus ordering
 		dlist_reverse(windows);
+		job->xd = true;
+	}
+
+	if (threaded) {
+		if (!pthread_create(&job->thread, NULL, layout_job_compute, job))
+			job->threaded = true;
+		else
+			printfef(false, "(): failed to start the layout thread, laying out now");
 	}
+	if (!job->threaded)
+		layout_job_compute(job);
+
+	return job;
+}
+
+void
+layout_job_finish(layout_job_t *job,
+		unsigned int *total_width, unsigned int *total_height) {
+	if (job->threaded)
+		pthread_join(job->thread, NULL);
+
+	// the worker leaves reporting and the warm table to the main thread
+	if (job->cosmos) {
+		layout_cosmos_report(&job->cosmos_ws);
+		if (job->result != &job->cosmos_ws)
+			printfdf(false, "(): falling back to the xd layout");
+		layout_warm_update(&job->mw->cosmos_warm, &job->cosmos_ws);
+	}
+
+	if (job->cached) {
+		*total_width = job->total_width;
+		*total_height = job->total_height;
+		free(job->key.windows);
+	}
+	else {
+		if (job->result) {
+			layout_ws_apply(job->result);
+			*total_width = job->result->total_width;
+			*total_height = job->result->total_height;
+		}
+		// a layout cut short by the time budget gets another chance
+		// next time
+		if (job->cosmos && job->cosmos_ws.timed_out)
+			free(job->key.windows);
+		else
+			layout_cache_store(job->cache, &job->key, job->cws,
+					*total_width, *total_height);
+	}
+
+	if (job->cosmos)
+		layout_ws_free(&job->cosmos_ws);
+	if (job->xd)
+		layout_ws_free(&job->xd_ws);
+	free(job->cws);
+	free(job);
+}
+
+// this function redirects to different functions
+// which performs the expose layout
+// by calaculating cw->x, cw->y (new coordinates)
+// and total_width, total_height
+// given cw->src.x, cw->src.y (original coordinates)
+
+void layout_run(MainWin *mw, dlist *windows,
+		unsigned int *total_width, unsigned int *total_height,
+		enum layoutmode layout) {
+	layout_job_finish(layout_job_start(mw, windows, false),
+			total_width, total_height);
 }
 
 // original legacy layout
 //
 //
 void
-layout_xd(MainWin *mw, dlist *windows,
-		unsigned int *total_width, unsigned int *total_height)
+layout_xd(MainWin *mw, layout_ws_t *ws)
 {
 	int sum_w = 0, max_h = 0, max_w = 0;
 	int count = 0;
+	int n = ws->n;
+	int distance = ws->distance;
 
-	dlist *slots = NULL;
-
-	windows = dlist_first(windows);
-	*total_width = *total_height = 0;
+	ws->total_width = ws->total_height = 0;
 
 	// Get total window width and max window width/height
-	foreach_dlist (windows) {
-		ClientWin *cw = (ClientWin *) iter->data;
-		if (!cw->mode) continue;
-		sum_w += cw->src.width;
-		max_w = MAX(max_w, cw->src.width);
-		max_h = MAX(max_h, cw->src.height);
+	for (int i = 0; i < n; i++) {
+		if (ws->hidden[i]) continue;
+		sum_w += ws->width[i];
+		max_w = MAX(max_w, ws->width[i]);
+		max_h = MAX(max_h, ws->height[i]);
 		count++;
 	}
 
 	/* If single-row layout is enabled and the number of visible windows is
 	 * less than or equal to layoutOneRowItems, arrange them in a single row. */
-	if (mw->ps->o.layoutOneRow && count > 0 && count <= mw->ps->o.layoutOneRowItems) {
+	if (ws->one_row && count > 0 && count <= ws->one_row_items) {
 		int x = 0;
-		foreach_dlist (windows) {
-			ClientWin *cw = (ClientWin *) iter->data;
-			if (!cw->mode) continue;
-			cw->x = x;
-			cw->y = (max_h - cw->src.height) / 2;
-			x += cw->src.width + mw->distance;
-		}
-		*total_width = x - mw->distance;
-		*total_height = max_h;
+		for (int i = 0; i < n; i++) {
+			if (ws->hidden[i]) continue;
+			ws->x[i] = x;
+			ws->y[i] = (max_h - ws->height[i]) / 2;
+			x += ws->width[i] + distance;
+		}
+		ws->total_width = x - distance;
+		ws->total_height = max_h;
 		return;
 	}
 
+	// slots are vertical stacks of windows, chained through next[],
+	// a min tree over the slot heights finds the first slot a window fits in
+	int size = MAX(n, 1);
+	int leaves = 1;
+	while (leaves < size)
+		leaves *= 2;
+	int *mem = smalloc(6 * size + 2 + 2 * leaves, int);
+	int *next = mem;
+	int *slot_first = next + size;
+	int *slot_last = slot_first + size;
+	int *slot_h = slot_last + size;
+	int *order = slot_h + size;
+	int *row_start = order + size;
+	int *tree = row_start + size + 2;
+	int nslots = 0;
+
+	// slots yet to be created never fit
+	for (int k = 1; k < 2 * leaves; k++)
+		tree[k] = INT_MAX;
+
 	// Vertical layout
-	foreach_dlist (windows) {
-		ClientWin *cw = (ClientWin*) iter->data;
-		if (!cw->mode) continue;
-		dlist *slot_iter = dlist_first(slots);
-		for (; slot_iter; slot_iter = slot_iter->next) {
-			dlist *slot = (dlist *) slot_iter->data;
-			// Calculate current total height of slot
-			int slot_h = - mw->distance;
-			foreach_dlist_vn(slot_cw_iter, slot) {
-				ClientWin *slot_cw = (ClientWin *) slot_cw_iter->data;
-				slot_h = slot_h + slot_cw->src.height + mw->distance;
-			}
-			// Add window to slot if the slot height after adding the window
-			// doesn't exceed max window height
-			if (slot_h + mw->distance + cw->src.height < max_h) {
-				slot_iter->data = dlist_add(slot, cw);
-				break;
-			}
+	for (int i = 0; i < n; i++) {
+		if (ws->hidden[i]) continue;
+		next[i] = -1;
+		// Add window to the first slot whose height after adding the window
+		// doesn't exceed max window height
+		int fit = max_h - distance - ws->height[i];
+		int s = nslots;
+		if (tree[1] < fit) {
+			int k = 1;
+			while (k < leaves)
+				k = tree[2 * k] < fit ? 2 * k : 2 * k + 1;
+			s = k - leaves;
+			next[slot_last[s]] = i;
+			slot_last[s] = i;
+			slot_h[s] += distance + ws->height[i];
 		}
 		// Otherwise, create a new slot with only this window
-		if (!slot_iter)
-			slots = dlist_add(slots, dlist_add(NULL, cw));
+		else {
+			slot_first[nslots] = slot_last[nslots] = i;
+			slot_h[nslots] = ws->height[i];
+			nslots++;
+		}
+		tree[s + leaves] = slot_h[s];
+		for (int k = (s + leaves) / 2; k >= 1; k /= 2)
+			tree[k] = MIN(tree[2 * k], tree[2 * k + 1]);
 	}
 
-	dlist *rows = dlist_add(NULL, NULL);
+	// windows in placement order, rows being consecutive runs of it
+	int nplaced = 0, nrows = 0;
+	row_start[0] = 0;
 	{
 		int row_y = 0, x = 0, row_h = 0;
 		int max_row_w = sqrt(sum_w * max_h);
-		foreach_dlist_vn (slot_iter, slots) {
-			dlist *slot = (dlist *) slot_iter->data;
+		for (int s = 0; s < nslots; s++) {
 			// Max width of windows in the slot
 			int slot_max_w = 0;
-			foreach_dlist_vn (slot_cw_iter, slot) {
-				ClientWin *cw = (ClientWin *) slot_cw_iter->data;
-				slot_max_w = MAX(slot_max_w, cw->src.width);
-			}
+			for (int i = slot_first[s]; i >= 0; i = next[i])
+				slot_max_w = MAX(slot_max_w, ws->width[i]);
 			int y = row_y;
-			foreach_dlist_vn (slot_cw_iter, slot) {
-				ClientWin *cw = (ClientWin *) slot_cw_iter->data;
-				cw->x = x + (slot_max_w - cw->src.width) / 2;
-				cw->y = y;
-				y += cw->src.height + mw->distance;
-				rows->data = dlist_add(rows->data, cw);
+			for (int i = slot_first[s]; i >= 0; i = next[i]) {
+				ws->x[i] = x + (slot_max_w - ws->width[i]) / 2;
+				ws->y[i] = y;
+				y += ws->height[i] + distance;
+				order[nplaced++] = i;
 			}
 			row_h = MAX(row_h, y - row_y);
-			*total_height = MAX(*total_height, y);
-			x += slot_max_w + mw->distance;
-			*total_width = MAX(*total_width, x);
+			ws->total_height = MAX(ws->total_height, y);
+			x += slot_max_w + distance;
+			ws->total_width = MAX(ws->total_width, x);
 			if (x > max_row_w) {
 				x = 0;
 				row_y += row_h;
 				row_h = 0;
-				rows = dlist_add(rows, 0);
+				row_start[++nrows] = nplaced;
 			}
-			dlist_free(slot);
 		}
-		dlist_free(slots);
-		slots = NULL;
+		row_start[++nrows] = nplaced;
 	}
 
-	*total_width -= mw->distance;
-	*total_height -= mw->distance;
+	ws->total_width -= distance;
+	ws->total_height -= distance;
 
-	foreach_dlist (rows) {
-		dlist *row = (dlist *) iter->data;
+	for (int r = 0; r < nrows; r++) {
 		int row_w = 0, xoff;
-		foreach_dlist_vn (slot_cw_iter, row) {
-			ClientWin *cw = (ClientWin *) slot_cw_iter->data;
-			row_w = MAX(row_w, cw->x + cw->src.width);
-		}
-		xoff = (*total_width - row_w) / 2;
-		foreach_dlist_vn (cw_iter, row) {
-			ClientWin *cw = (ClientWin *) cw_iter->data;
-			cw->x += xoff;
-		}
-		dlist_free(row);
+		for (int k = row_start[r]; k < row_start[r + 1]; k++)
+			row_w = MAX(row_w, ws->x[order[k]] + ws->width[order[k]]);
+		xoff = (ws->total_width - row_w) / 2;
+		for (int k = row_start[r]; k < row_start[r + 1]; k++)
+			ws->x[order[k]] += xoff;
 	}
 
-	dlist_free(rows);
+	free(mem);
 }
 
-float
-intersectArea(ClientWin *cw1, ClientWin *cw2,
-		unsigned int *total_width, unsigned int *total_height) {
-	int dis = cw1->mainwin->distance / 2;
-	float disx = (float)dis / (float) *total_width;
-	float disy = (float)dis / (float) *total_height;
-	float x1 = cw1->fx - disx, x2 = cw2->fx - disx;
-	float y1 = cw1->fy - disy, y2 = cw2->fy - disy;
-	float w1 = (float)cw1->src.width / (float) *total_width + 2*disx,
-		  w2 = (float)cw2->src.width / (float) *total_width + 2*disx;
-	float h1 = (float)cw1->src.height / (float) *total_height + 2*disy,
-		  h2 = (float)cw2->src.height / (float) *total_height + 2*disy;
+// whether the boxes of two windows, padded by half the distance, overlap
+static inline bool
+cosmos_overlap(const layout_ws_t *ws, int i, int j) {
+	float x1 = ws->fx[i] - ws->padx, x2 = ws->fx[j] - ws->padx;
+	float y1 = ws->fy[i] - ws->pady, y2 = ws->fy[j] - ws->pady;
 
 	float left   = MAX(x1, x2);
 	float top    = MAX(y1, y2);
-	float right  = MIN(x1 + w1, x2 + w2);
-	float bottom = MIN(y1 + h1, y2 + h2);
+	float right  = MIN(x1 + ws->pw[i], x2 + ws->pw[j]);
+	float bottom = MIN(y1 + ws->ph[i], y2 + ws->ph[j]);
 
 	if (right < left || bottom < top)
-		return 0;
+		return false;
 
-	return (right - left) * (bottom - top);
+	return (right - left) * (bottom - top) > 0;
 }
 
 static inline float
@@ -231,10 +635,9 @@ ABS(float x) {
 }
 
 static void
-com(ClientWin *cw, float *x, float *y,
-		unsigned int *total_width, unsigned int *total_height) {
-	*x = cw->fx + (float)cw->src.width / 2.0 / *total_width;
-	*y = cw->fy + (float)cw->src.height / 2.0 / *total_height;
+com(const layout_ws_t *ws, int i, float *x, float *y) {
+	*x = ws->fx[i] + (float)ws->width[i] / 2.0 / ws->total_width;
+	*y = ws->fy[i] + (float)ws->height[i] / 2.0 / ws->total_height;
 }
 
 static inline void
@@ -251,270 +654,1196 @@ inverse2(float dx, float dy, float *ax, float *ay) {
 	*ay = acc * dy / dist;
 }
 
-void
-layout_cosmos(MainWin *mw, dlist *windows,
-		unsigned int *total_width, unsigned int *total_height)
+// uniform grid broadphase for the cosmos collision tests
+//
+// every window is registered in all the cells its padded box covers,
+// cells being hashed into a power-of-two number of buckets;
+// two boxes sharing a point always share a cell,
+// so a query can return false candidates but never misses a real one
+typedef struct {
+	int *items;
+	int count, capacity;
+} gridbucket_t;
+
+typedef struct {
+	// no cells, every window is a candidate
+	bool direct;
+	float cell;
+	unsigned int mask;
+	gridbucket_t *buckets;
+	// cells each window is currently registered in
+	int *cx0, *cy0, *cx1, *cy1;
+	bool *registered;
+	// query scratch space, candidates come out in ascending order
+	unsigned int *stamp;
+	unsigned int curstamp;
+	int *result;
+	int nresult;
+	// what the last query returned, in result
+	const int *candidates;
+	int n;
+} spatialgrid_t;
+
+static void
+grid_init(spatialgrid_t *grid, int n, float cell, bool direct) {
+	unsigned int nbuckets = 16;
+	while (nbuckets < 2 * (unsigned int) n)
+		nbuckets <<= 1;
+
+	grid->direct = direct || n < GRID_MIN_WINDOWS;
+	if (grid->direct)
+		nbuckets = 1;
+	grid->cell = cell;
+	grid->mask = nbuckets - 1;
+	grid->buckets = scalloc(nbuckets, gridbucket_t);
+	grid->cx0 = smalloc(n, int);
+	grid->cy0 = smalloc(n, int);
+	grid->cx1 = smalloc(n, int);
+	grid->cy1 = smalloc(n, int);
+	grid->registered = scalloc(n, bool);
+	grid->stamp = scalloc(n, unsigned int);
+	grid->curstamp = 0;
+	grid->result = smalloc(n, int);
+	grid->nresult = 0;
+	grid->n = n;
+
+	// in direct mode the result never changes
+	if (grid->direct)
+		for (int i = 0; i < n; i++)
+			grid->result[i] = i;
+}
+
+static void
+grid_free(spatialgrid_t *grid) {
+	for (unsigned int i = 0; i <= grid->mask; i++)
+		free(grid->buckets[i].items);
+	free(grid->buckets);
+	free(grid->cx0);
+	free(grid->cy0);
+	free(grid->cx1);
+	free(grid->cy1);
+	free(grid->registered);
+	free(grid->stamp);
+	free(grid->result);
+}
+
+static void
+grid_clear(spatialgrid_t *grid) {
+	for (unsigned int i = 0; i <= grid->mask; i++)
+		grid->buckets[i].count = 0;
+	for (int i = 0; i < grid->n; i++)
+		grid->registered[i] = false;
+}
+
+static inline int
+grid_coord(const spatialgrid_t *grid, float x) {
+	float c = floorf(x / grid->cell);
+	if (c < -1e6)
+		return -1000000;
+	if (c > 1e6)
+		return 1000000;
+	return (int) c;
+}
+
+static inline unsigned int
+grid_hash(const spatialgrid_t *grid, int cx, int cy) {
+	return ((unsigned int) cx * 73856093u
+			^ (unsigned int) cy * 19349663u) & grid->mask;
+}
+
+// boxes covering more cells than there are buckets
+// simply live in every bucket
+static inline bool
+grid_wide(const spatialgrid_t *grid, int cx0, int cy0, int cx1, int cy1) {
+	return (double) (cx1 - cx0 + 1) * (double) (cy1 - cy0 + 1)
+		> (double) grid->mask + 1;
+}
+
+static void
+grid_bucket_add(gridbucket_t *bucket, int idx) {
+	if (bucket->count == bucket->capacity) {
+		bucket->capacity = MAX(4, bucket->capacity * 2);
+		bucket->items = srealloc(bucket->items, bucket->capacity, int);
+	}
+	bucket->items[bucket->count++] = idx;
+}
+
+static void
+grid_bucket_remove(gridbucket_t *bucket, int idx) {
+	for (int i = 0; i < bucket->count; i++) {
+		if (bucket->items[i] == idx) {
+			bucket->items[i] = bucket->items[--bucket->count];
+			return;
+		}
+	}
+}
+
+static void
+grid_insert(spatialgrid_t *grid, int idx,
+		float x0, float y0, float x1, float y1) {
+	if (grid->direct)
+		return;
+
+	int cx0 = grid_coord(grid, x0), cy0 = grid_coord(grid, y0);
+	int cx1 = grid_coord(grid, x1), cy1 = grid_coord(grid, y1);
+
+	grid->cx0[idx] = cx0;
+	grid->cy0[idx] = cy0;
+	grid->cx1[idx] = cx1;
+	grid->cy1[idx] = cy1;
+	grid->registered[idx] = true;
+
+	if (grid_wide(grid, cx0, cy0, cx1, cy1)) {
+		for (unsigned int i = 0; i <= grid->mask; i++)
+			grid_bucket_add(&grid->buckets[i], idx);
+		return;
+	}
+
+	for (int cy = cy0; cy <= cy1; cy++)
+		for (int cx = cx0; cx <= cx1; cx++)
+			grid_bucket_add(&grid->buckets[grid_hash(grid, cx, cy)], idx);
+}
+
+static void
+grid_remove(spatialgrid_t *grid, int idx) {
+	if (grid->direct || !grid->registered[idx])
+		return;
+	grid->registered[idx] = false;
+
+	int cx0 = grid->cx0[idx], cy0 = grid->cy0[idx];
+	int cx1 = grid->cx1[idx], cy1 = grid->cy1[idx];
+
+	if (grid_wide(grid, cx0, cy0, cx1, cy1)) {
+		for (unsigned int i = 0; i <= grid->mask; i++)
+			grid_bucket_remove(&grid->buckets[i], idx);
+		return;
+	}
+
+	for (int cy = cy0; cy <= cy1; cy++)
+		for (int cx = cx0; cx <= cx1; cx++)
+			grid_bucket_remove(&grid->buckets[grid_hash(grid, cx, cy)], idx);
+}
+
+static inline void
+grid_collect(spatialgrid_t *grid, const gridbucket_t *bucket, int after) {
+	for (int i = 0; i < bucket->count; i++) {
+		int idx = bucket->items[i];
+		if (idx <= after || grid->stamp[idx] == grid->curstamp)
+			continue;
+		grid->stamp[idx] = grid->curstamp;
+		grid->result[grid->nresult++] = idx;
+	}
+}
+
+// collect the windows with an index greater than after
+// whose box may overlap the given one into grid->candidates,
+// in ascending index order
+static int
+grid_query(spatialgrid_t *grid, int after,
+		float x0, float y0, float x1, float y1) {
+	if (grid->direct) {
+		grid->candidates = grid->result + after + 1;
+		return grid->n - after - 1;
+	}
+
+	int cx0 = grid_coord(grid, x0), cy0 = grid_coord(grid, y0);
+	int cx1 = grid_coord(grid, x1), cy1 = grid_coord(grid, y1);
+
+	grid->candidates = grid->result;
+	grid->nresult = 0;
+	if (++grid->curstamp == 0) {
+		grid->curstamp = 1;
+		memset(grid->stamp, 0, grid->n * sizeof(unsigned int));
+	}
+
+	if (grid_wide(grid, cx0, cy0, cx1, cy1)) {
+		for (unsigned int i = 0; i <= grid->mask; i++)
+			grid_collect(grid, &grid->buckets[i], after);
+	}
+	else {
+		for (int cy = cy0; cy <= cy1; cy++)
+			for (int cx = cx0; cx <= cx1; cx++)
+				grid_collect(grid,
+						&grid->buckets[grid_hash(grid, cx, cy)], after);
+	}
+
+	// few candidates are sorted in place, many are picked up in order
+	// from the stamps
+	int *result = grid->result;
+	if (grid->nresult <= 32) {
+		for (int i = 1; i < grid->nresult; i++) {
+			int idx = result[i], j = i;
+			for (; j > 0 && result[j - 1] > idx; j--)
+				result[j] = result[j - 1];
+			result[j] = idx;
+		}
+	}
+	else {
+		grid->nresult = 0;
+		for (int idx = after + 1; idx < grid->n; idx++)
+			if (grid->stamp[idx] == grid->curstamp)
+				result[grid->nresult++] = idx;
+	}
+	return grid->nresult;
+}
+
+// the box cosmos_overlap() tests, padded by a hair against rounding
+static inline void
+cosmos_box(const layout_ws_t *ws, int i,
+		float *x0, float *y0, float *x1, float *y1) {
+	float eps = 1e-4;
+	*x0 = ws->fx[i] - ws->padx;
+	*y0 = ws->fy[i] - ws->pady;
+	*x1 = *x0 + ws->pw[i] + eps;
+	*y1 = *y0 + ws->ph[i] + eps;
+	*x0 -= eps;
+	*y0 -= eps;
+}
+
+// Barnes-Hut quadtree over the centres of mass, for the collapse
+//
+// a cell seen from a window under less than the opening angle attracts it
+// as a single body of the cell's mass at the cell's centre of mass;
+// cells are split until they hold one window, or up to QTREE_MAX_DEPTH
+// where windows with the same centre share a leaf
+#define QTREE_MAX_DEPTH 24
+
+typedef struct {
+	float x0, y0, size;
+	// total mass, and its centre
+	float mass, cx, cy;
+	// first child, the others following, or -1 for a leaf
+	int child;
+	int nchildren;
+	// windows of a leaf, in order[first .. first + count)
+	int first, count;
+} qtnode_t;
+
+typedef struct {
+	qtnode_t *nodes;
+	int nnodes, capacity;
+	// window indices, grouped by leaf
+	int *order, *scratch;
+	// nodes still to visit during a walk
+	int *stack;
+	int stack_capacity;
+} qtree_t;
+
+static void
+qtree_init(qtree_t *tree, int n) {
+	tree->capacity = MAX(2 * n, 16);
+	tree->nodes = smalloc(tree->capacity, qtnode_t);
+	tree->nnodes = 0;
+	tree->order = smalloc(MAX(n, 1), int);
+	tree->scratch = smalloc(MAX(n, 1), int);
+	tree->stack_capacity = 64;
+	tree->stack = smalloc(tree->stack_capacity, int);
+}
+
+static void
+qtree_free(qtree_t *tree) {
+	free(tree->nodes);
+	free(tree->order);
+	free(tree->scratch);
+	free(tree->stack);
+}
+
+static int
+qtree_node(qtree_t *tree, float x0, float y0, float size) {
+	if (tree->nnodes == tree->capacity) {
+		tree->capacity *= 2;
+		tree->nodes = srealloc(tree->nodes, tree->capacity, qtnode_t);
+	}
+	qtnode_t *node = &tree->nodes[tree->nnodes];
+	node->x0 = x0;
+	node->y0 = y0;
+	node->size = size;
+	node->child = -1;
+	node->nchildren = 0;
+	node->first = node->count = 0;
+	return tree->nnodes++;
+}
+
+// lay out the cell of node over order[first .. first + count)
+static void
+qtree_split(qtree_t *tree, const layout_ws_t *ws, int idx,
+		int first, int count, int depth) {
+	qtnode_t *node = &tree->nodes[idx];
+	node->first = first;
+	node->count = count;
+
+	double mass = 0, mx = 0, my = 0;
+	for (int k = first; k < first + count; k++) {
+		int i = tree->order[k];
+		mass += ws->mass[i];
+		mx += (double) ws->mass[i] * ws->cx[i];
+		my += (double) ws->mass[i] * ws->cy[i];
+	}
+	node->mass = mass;
+	node->cx = mass > 0 ? mx / mass : ws->cx[tree->order[first]];
+	node->cy = mass > 0 ? my / mass : ws->cy[tree->order[first]];
+
+	if (count <= 1 || depth >= QTREE_MAX_DEPTH)
+		return;
+
+	// group the windows by quadrant, keeping their order within each
+	float half = node->size / 2;
+	float midx = node->x0 + half, midy = node->y0 + half;
+	int counts[4] = { 0 };
+	for (int k = first; k < first + count; k++) {
+		int i = tree->order[k];
+		counts[(ws->cx[i] >= midx) + 2 * (ws->cy[i] >= midy)]++;
+	}
+	int starts[4] = { first };
+	for (int q = 1; q < 4; q++)
+		starts[q] = starts[q - 1] + counts[q - 1];
+	{
+		int pos[4] = { starts[0], starts[1], starts[2], starts[3] };
+		for (int k = first; k < first + count; k++) {
+			int i = tree->order[k];
+			tree->scratch[pos[(ws->cx[i] >= midx) + 2 * (ws->cy[i] >= midy)]++] = i;
+		}
+		memcpy(tree->order + first, tree->scratch + first, count * sizeof(int));
+	}
+
+	// children are allocated next to each other, then filled in
+	int child = -1, nchildren = 0;
+	for (int q = 0; q < 4; q++) {
+		if (!counts[q])
+			continue;
+		int c = qtree_node(tree, node->x0 + (q & 1) * half,
+				node->y0 + (q >> 1) * half, half);
+		if (child < 0)
+			child = c;
+		nchildren++;
+	}
+	tree->nodes[idx].child = child;
+	tree->nodes[idx].nchildren = nchildren;
+	for (int q = 0, c = child; q < 4; q++) {
+		if (!counts[q])
+			continue;
+		qtree_split(tree, ws, c++, starts[q], counts[q], depth + 1);
+	}
+}
+
+// build the tree over the current centres of mass
+static void
+qtree_build(qtree_t *tree, const layout_ws_t *ws) {
+	float x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY;
+	for (int i = 0; i < ws->n; i++) {
+		tree->order[i] = i;
+		x0 = MIN(x0, ws->cx[i]);
+		y0 = MIN(y0, ws->cy[i]);
+		x1 = MAX(x1, ws->cx[i]);
+		y1 = MAX(y1, ws->cy[i]);
+	}
+	tree->nnodes = 0;
+	if (!ws->n)
+		return;
+	// a hair larger, so that the far edge falls inside the last cells
+	float size = MAX(x1 - x0, y1 - y0) * (1 + 1e-4) + 1e-6;
+	qtree_split(tree, ws, qtree_node(tree, x0, y0, size), 0, ws->n, 0);
+}
+
+// add the attraction of every other window on window i to its velocity,
+// cells seen under less than theta standing for their windows
+static void
+qtree_attract(qtree_t *tree, layout_ws_t *ws, int i, float theta, float aratio) {
+	float x = ws->cx[i], y = ws->cy[i];
+	int top = 0;
+	tree->stack[top++] = 0;
+	while (top) {
+		const qtnode_t *node = &tree->nodes[tree->stack[--top]];
+
+		if (node->child < 0) {
+			for (int k = node->first; k < node->first + node->count; k++) {
+				int j = tree->order[k];
+				if (i == j)
+					continue;
+				float ax=0, ay=0;
+				inverse2(ws->cx[j] - x, ws->cy[j] - y, &ax, &ay);
+				ws->vx[i] += 1e-1 * ws->mass[j] * ax;
+				ws->vy[i] += 1e-1 * ws->mass[j] * ay / aratio;
+			}
+			continue;
+		}
+
+		float dx = node->cx - x, dy = node->cy - y;
+		bool inside = x >= node->x0 && x < node->x0 + node->size
+			&& y >= node->y0 && y < node->y0 + node->size;
+		if (!inside && node->size < theta * sqrtf(dx*dx + dy*dy)) {
+			float ax=0, ay=0;
+			inverse2(dx, dy, &ax, &ay);
+			ws->vx[i] += 1e-1 * node->mass * ax;
+			ws->vy[i] += 1e-1 * node->mass * ay / aratio;
+			continue;
+		}
+
+		if (top + node->nchildren > tree->stack_capacity) {
+			tree->stack_capacity *= 2;
+			tree->stack = srealloc(tree->stack, tree->stack_capacity, int);
+		}
+		// pushed last first, so that cells are visited in order
+		for (int c = node->child + node->nchildren - 1; c >= node->child; c--)
+			tree->stack[top++] = c;
+	}
+}
+
+// exact attraction of every other window on each free window, as added to
+// the velocities by the collapse; the vector kernels below give the very
+// same sums, window i's terms being added in the order of j in all of them
+typedef void (*cosmos_attract_func)(layout_ws_t *ws, int from, float aratio);
+
+static void
+cosmos_attract_scalar(layout_ws_t *ws, int from, float aratio) {
+	for (int i = from; i < ws->n; i++) {
+		if (ws->pinned[i])
+			continue;
+		for (int j = 0; j < ws->n; j++) {
+			if (i == j)
+				continue;
+
+			float dx = ws->cx[j] - ws->cx[i];
+			float dy = ws->cy[j] - ws->cy[i];
+			float ax=0, ay=0;
+			inverse2(dx, dy, &ax, &ay);
+			ws->vx[i] += 1e-1 * ws->mass[j] * ax;
+			ws->vy[i] += 1e-1 * ws->mass[j] * ay / aratio /* * 2.0*/;
+		}
+	}
+}
+
+#ifdef COSMOS_SIMD
+// Lanes are windows i, j being broadcast. Each step is the scalar one:
+// float where inverse2() works in float, double where it and the sums
+// promote to double. A window's own term is a zero added to its velocity,
+// which never is a negative zero, so it needs no masking; nor do pinned
+// windows, whose lanes are simply not stored.
+
+// in double, 1.0 / dist / dist for the lanes of dist
+__attribute__((target("sse2")))
+static inline __m128
+cosmos_acc_sse2(__m128 dist) {
+	const __m128d one = _mm_set1_pd(1.0);
+	__m128d lo = _mm_cvtps_pd(dist);
+	__m128d hi = _mm_cvtps_pd(_mm_movehl_ps(dist, dist));
+	return _mm_movelh_ps(_mm_cvtpd_ps(_mm_div_pd(_mm_div_pd(one, lo), lo)),
+			_mm_cvtpd_ps(_mm_div_pd(_mm_div_pd(one, hi), hi)));
+}
+
+// in double, v + m * a, or (m * a) / r when r is given
+__attribute__((target("sse2")))
+static inline __m128
+cosmos_add_sse2(__m128 v, __m128d m, __m128 a, const __m128d *r) {
+	__m128d vlo = _mm_cvtps_pd(v), vhi = _mm_cvtps_pd(_mm_movehl_ps(v, v));
+	__m128d tlo = _mm_mul_pd(m, _mm_cvtps_pd(a));
+	__m128d thi = _mm_mul_pd(m, _mm_cvtps_pd(_mm_movehl_ps(a, a)));
+	if (r) {
+		tlo = _mm_div_pd(tlo, *r);
+		thi = _mm_div_pd(thi, *r);
+	}
+	return _mm_movelh_ps(_mm_cvtpd_ps(_mm_add_pd(vlo, tlo)),
+			_mm_cvtpd_ps(_mm_add_pd(vhi, thi)));
+}
+
+__attribute__((target("sse2")))
+static void
+cosmos_attract_sse2(layout_ws_t *ws, int from, float aratio) {
+	const __m128 near = _mm_set1_ps(0.01f);
+	const __m128d r = _mm_set1_pd(aratio);
+	int n = ws->n, i0 = from;
+	for (; i0 + 4 <= n; i0 += 4) {
+		__m128 x = _mm_loadu_ps(ws->cx + i0), y = _mm_loadu_ps(ws->cy + i0);
+		__m128 vx = _mm_loadu_ps(ws->vx + i0), vy = _mm_loadu_ps(ws->vy + i0);
+		for (int j = 0; j < n; j++) {
+			__m128 dx = _mm_sub_ps(_mm_set1_ps(ws->cx[j]), x);
+			__m128 dy = _mm_sub_ps(_mm_set1_ps(ws->cy[j]), y);
+			__m128 dist = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx),
+						_mm_mul_ps(dy, dy)));
+			// dist < 0.01 in double is dist <= 0.01f in float
+			__m128 skip = _mm_cmple_ps(dist, near);
+			__m128 acc = cosmos_acc_sse2(dist);
+			__m128 ax = _mm_andnot_ps(skip, _mm_div_ps(_mm_mul_ps(acc, dx), dist));
+			__m128 ay = _mm_andnot_ps(skip, _mm_div_ps(_mm_mul_ps(acc, dy), dist));
+			__m128d m = _mm_set1_pd(1e-1 * ws->mass[j]);
+			vx = cosmos_add_sse2(vx, m, ax, NULL);
+			vy = cosmos_add_sse2(vy, m, ay, &r);
+		}
+		float ox[4], oy[4];
+		_mm_storeu_ps(ox, vx);
+		_mm_storeu_ps(oy, vy);
+		for (int l = 0; l < 4; l++) {
+			if (ws->pinned[i0 + l])
+				continue;
+			ws->vx[i0 + l] = ox[l];
+			ws->vy[i0 + l] = oy[l];
+		}
+	}
+	cosmos_attract_scalar(ws, i0, aratio);
+}
+
+__attribute__((target("avx2")))
+static inline __m256
+cosmos_acc_avx2(__m256 dist) {
+	const __m256d one = _mm256_set1_pd(1.0);
+	__m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(dist));
+	__m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(dist, 1));
+	return _mm256_set_m128(
+			_mm256_cvtpd_ps(_mm256_div_pd(_mm256_div_pd(one, hi), hi)),
+			_mm256_cvtpd_ps(_mm256_div_pd(_mm256_div_pd(one, lo), lo)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256
+cosmos_add_avx2(__m256 v, __m256d m, __m256 a, const __m256d *r) {
+	__m256d vlo = _mm256_cvtps_pd(_mm256_castps256_ps128(v));
+	__m256d vhi = _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1));
+	__m256d tlo = _mm256_mul_pd(m, _mm256_cvtps_pd(_mm256_castps256_ps128(a)));
+	__m256d thi = _mm256_mul_pd(m, _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1)));
+	if (r) {
+		tlo = _mm256_div_pd(tlo, *r);
+		thi = _mm256_div_pd(thi, *r);
+	}
+	return _mm256_set_m128(_mm256_cvtpd_ps(_mm256_add_pd(vhi, thi)),
+			_mm256_cvtpd_ps(_mm256_add_pd(vlo, tlo)));
+}
+
+__attribute__((target("avx2")))
+static void
+cosmos_attract_avx2(layout_ws_t *ws, int from, float aratio) {
+	const __m256 near = _mm256_set1_ps(0.01f);
+	const __m256d r = _mm256_set1_pd(aratio);
+	int n = ws->n, i0 = from;
+	for (; i0 + 8 <= n; i0 += 8) {
+		__m256 x = _mm256_loadu_ps(ws->cx + i0), y = _mm256_loadu_ps(ws->cy + i0);
+		__m256 vx = _mm256_loadu_ps(ws->vx + i0), vy = _mm256_loadu_ps(ws->vy + i0);
+		for (int j = 0; j < n; j++) {
+			__m256 dx = _mm256_sub_ps(_mm256_set1_ps(ws->cx[j]), x);
+			__m256 dy = _mm256_sub_ps(_mm256_set1_ps(ws->cy[j]), y);
+			__m256 dist = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx),
+						_mm256_mul_ps(dy, dy)));
+			__m256 skip = _mm256_cmp_ps(dist, near, _CMP_LE_OQ);
+			__m256 acc = cosmos_acc_avx2(dist);
+			__m256 ax = _mm256_andnot_ps(skip,
+					_mm256_div_ps(_mm256_mul_ps(acc, dx), dist));
+			__m256 ay = _mm256_andnot_ps(skip,
+					_mm256_div_ps(_mm256_mul_ps(acc, dy), dist));
+			__m256d m = _mm256_set1_pd(1e-1 * ws->mass[j]);
+			vx = cosmos_add_avx2(vx, m, ax, NULL);
+			vy = cosmos_add_avx2(vy, m, ay, &r);
+		}
+		float ox[8], oy[8];
+		_mm256_storeu_ps(ox, vx);
+		_mm256_storeu_ps(oy, vy);
+		for (int l = 0; l < 8; l++) {
+			if (ws->pinned[i0 + l])
+				continue;
+			ws->vx[i0 + l] = ox[l];
+			ws->vy[i0 + l] = oy[l];
+		}
+	}
+	cosmos_attract_sse2(ws, i0, aratio);
+}
+#endif /* COSMOS_SIMD */
+
+// the widest kernel the CPU runs
+static cosmos_attract_func
+cosmos_attract_kernel(const layout_ws_t *ws) {
+#ifdef COSMOS_SIMD
+	if (!ws->scalar) {
+		if (__builtin_cpu_supports("avx2"))
+			return cosmos_attract_avx2;
+		if (__builtin_cpu_supports("sse2"))
+			return cosmos_attract_sse2;
+	}
+#endif
+	return cosmos_attract_scalar;
+}
+
+// collapse iterations between two looks for the best layout so far,
+// the collision check being quadratic below GRID_MIN_WINDOWS
+#define COSMOS_SNAPSHOT_INTERVAL 16
+
+// uniform in [0, 1), from the workspace's own generator,
+// rand() being shared with the main thread
+static inline float
+cosmos_rand(layout_ws_t *ws) {
+	ws->seed = ws->seed * 6364136223846793005ULL + 1442695040888963407ULL;
+	return (float) (ws->seed >> 40) / (float) (1UL << 24);
+}
+
+static int
+warm_cmp_wid(const void *a, const void *b) {
+	Window wa = ((const layout_warm_entry_t *) a)->wid;
+	Window wb = ((const layout_warm_entry_t *) b)->wid;
+	return (wa > wb) - (wa < wb);
+}
+
+// fill entries with the windows' current geometry, and seed the windows
+// whose geometry matches the previous run with their converged position
+static int
+cosmos_warm_seed(layout_ws_t *ws, layout_warm_entry_t *entries, bool *removed) {
+	const layout_warm_t *warm = ws->warm;
+	bool usable = warm && warm->n > 0
+		&& warm->distance == ws->distance
+		&& warm->screen_width == ws->screen_width
+		&& warm->screen_height == ws->screen_height;
+	int npinned = 0, nknown = 0;
+
+	for (int i = 0; i < ws->n; i++) {
+		layout_warm_entry_t *e = &entries[i];
+		e->wid = ws->wid[i];
+		e->src_x = ws->x[i];
+		e->src_y = ws->y[i];
+		e->width = ws->width[i];
+		e->height = ws->height[i];
+		ws->pinned[i] = false;
+
+		const layout_warm_entry_t *prev = NULL;
+		if (usable)
+			prev = bsearch(e, warm->entries, warm->n, sizeof(*e), warm_cmp_wid);
+		if (prev)
+			nknown++;
+		if (!prev || prev->src_x != e->src_x || prev->src_y != e->src_y
+				|| prev->width != e->width || prev->height != e->height)
+			continue;
+
+		ws->pinned[i] = true;
+		ws->x[i] = prev->x;
+		ws->y[i] = prev->y;
+		npinned++;
+	}
+
+	// windows of the previous run that are gone leave gaps behind,
+	// unlike moved or resized ones, which are only set free
+	*removed = usable && nknown < warm->n;
+	return npinned;
+}
+
+// whether no two padded windows overlap, the grid being up to date
+static bool
+cosmos_collision_free(const layout_ws_t *ws, spatialgrid_t *grid) {
+	for (int i = 0; i < ws->n; i++) {
+		float x0, y0, x1, y1;
+		cosmos_box(ws, i, &x0, &y0, &x1, &y1);
+		int ncandidates = grid_query(grid, i, x0, y0, x1, y1);
+		for (int k = 0; k < ncandidates; k++)
+			if (cosmos_overlap(ws, i, grid->candidates[k]))
+				return false;
+	}
+	return true;
+}
+
+// push windows apart where they still overlap, with the margins of the
+// collapse: the expansion may run out of iterations with collisions left,
+// which the collapse only resolves for windows that keep moving. Of two
+// windows, the one farther from the centre moves outwards, along the axis
+// of least overlap, so that no window is pushed back and forth.
+static int
+cosmos_separate(layout_ws_t *ws, spatialgrid_t *grid) {
+	int n = ws->n;
+	float mx = (float) ws->distance / (float) ws->total_width / 2.0;
+	float my = (float) ws->distance / (float) ws->total_height / 2.0;
+
+	float centrex = 0, centrey = 0;
+	for (int i = 0; i < n; i++) {
+		centrex += ws->fx[i] + (float) ws->width[i] / ws->total_width / 2.0;
+		centrey += ws->fy[i] + (float) ws->height[i] / ws->total_height / 2.0;
+	}
+	centrex /= MAX(n, 1);
+	centrey /= MAX(n, 1);
+
+	int iterations = 0;
+	bool colliding = true;
+	while (colliding && iterations < 1000) {
+		colliding = false;
+		for (int i = 0; i < n; i++) {
+			if (ws->pinned[i])
+				continue;
+			float x0, y0, x1, y1;
+			cosmos_box(ws, i, &x0, &y0, &x1, &y1);
+			int ncandidates = grid_query(grid, -1, x0, y0, x1, y1);
+			// candidates are gathered again after each push, at most n times
+			int pushes = 0;
+			for (int k = 0; k < ncandidates; k++) {
+				int j = grid->candidates[k];
+				if (i == j)
+					continue;
+
+				float wi = (float) ws->width[i] / ws->total_width;
+				float wj = (float) ws->width[j] / ws->total_width;
+				float hi = (float) ws->height[i] / ws->total_height;
+				float hj = (float) ws->height[j] / ws->total_height;
+				float overlapX = MIN(ws->fx[i] + wi, ws->fx[j] + wj) + 2 * mx
+					- MAX(ws->fx[i], ws->fx[j]);
+				float overlapY = MIN(ws->fy[i] + hi, ws->fy[j] + hj) + 2 * my
+					- MAX(ws->fy[i], ws->fy[j]);
+				// windows the collapse left touching are apart
+				if (overlapX * ws->total_width < 0.5
+						|| overlapY * ws->total_height < 0.5)
+					continue;
+				colliding = true;
+
+				bool vertical = overlapY < overlapX;
+				float di = vertical ? ws->fy[i] + hi / 2 - centrey:
+					ws->fx[i] + wi / 2 - centrex;
+				float dj = vertical ? ws->fy[j] + hj / 2 - centrey:
+					ws->fx[j] + wj / 2 - centrex;
+				float dir;
+				if (ws->pinned[j])
+					dir = di < dj ? -1: 1;
+				else if (ABS(di) > ABS(dj) || (ABS(di) == ABS(dj) && i > j))
+					dir = di < 0 ? -1: 1;
+				else
+					continue;
+
+				if (vertical)
+					ws->fy[i] += dir * overlapY;
+				else
+					ws->fx[i] += dir * overlapX;
+
+				cosmos_box(ws, i, &x0, &y0, &x1, &y1);
+				grid_remove(grid, i);
+				grid_insert(grid, i, x0, y0, x1, y1);
+				if (++pushes < n) {
+					ncandidates = grid_query(grid, -1, x0, y0, x1, y1);
+					k = -1;
+				}
+			}
+		}
+		iterations++;
+	}
+	return iterations;
+}
+
+// area of the bounding box of all windows, normalized
+static float
+cosmos_extent(const layout_ws_t *ws) {
+	float x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY;
+	for (int i = 0; i < ws->n; i++) {
+		x0 = MIN(x0, ws->fx[i]);
+		y0 = MIN(y0, ws->fy[i]);
+		x1 = MAX(x1, ws->fx[i] + (float)ws->width[i] / ws->total_width);
+		y1 = MAX(y1, ws->fy[i] + (float)ws->height[i] / ws->total_height);
+	}
+	return (x1 - x0) * (y1 - y0);
+}
+
+bool
+layout_cosmos(MainWin *mw, layout_ws_t *ws)
 {
+	int n = ws->n;
+	float *fx = ws->fx, *fy = ws->fy;
+	float *vx = ws->vx, *vy = ws->vy;
+	bool *pinned = ws->pinned;
+
+	// windows unchanged since the previous run start where they settled
+	// and stay put, only the others go through the physics
+	layout_warm_entry_t *entries = smalloc(MAX(n, 1), layout_warm_entry_t);
+	bool removed = false;
+	int npinned = cosmos_warm_seed(ws, entries, &removed);
+	ws->npinned = npinned;
+	ws->warm_removed = removed;
+
+	// past the deadline, the most compact configuration without collisions
+	// seen so far is the result
+	int budget = ws->time_budget;
+	long deadline = time_in_millis() + budget;
+	bool timed_out = false;
+	float *best_fx = NULL, *best_fy = NULL;
+	float best_extent = INFINITY;
+	if (budget > 0) {
+		best_fx = smalloc(MAX(n, 1), float);
+		best_fy = smalloc(MAX(n, 1), float);
+	}
+
 	// convert pixel coordinates (x,y) to float coordinates (fx,fy)
 	// 0 <= fx, fy <= 1
 	// normalized by screen width/height
+	int minx = INT_MAX, miny = INT_MAX;
 	{
-		int minx = INT_MAX, maxx = INT_MIN;
-		int miny = INT_MAX, maxy = INT_MIN;
-		foreach_dlist (dlist_first(windows)) {
-			ClientWin *cw = iter->data;
-			minx = MIN(minx, cw->x);
-			maxx = MAX(maxx, cw->x + cw->src.width);
-			miny = MIN(miny, cw->y);
-			maxy = MAX(maxy, cw->y + cw->src.height);
+		int maxx = INT_MIN, maxy = INT_MIN;
+		for (int i = 0; i < n; i++) {
+			minx = MIN(minx, ws->x[i]);
+			maxx = MAX(maxx, ws->x[i] + ws->width[i]);
+			miny = MIN(miny, ws->y[i]);
+			maxy = MAX(maxy, ws->y[i] + ws->height[i]);
 		}
 
-		foreach_dlist (dlist_first(windows)) {
-			ClientWin *cw = iter->data;
-			cw->x -= minx;
-			cw->y -= miny;
+		for (int i = 0; i < n; i++) {
+			ws->x[i] -= minx;
+			ws->y[i] -= miny;
 		}
 
-		*total_width = maxx - minx;
-		*total_height = maxy - miny;
+		ws->total_width = maxx - minx;
+		ws->total_height = maxy - miny;
 
-		foreach_dlist (dlist_first(windows)) {
-			ClientWin *cw = iter->data;
-			cw->fx = (float)cw->x / (float)*total_width;
-			cw->fy = (float)cw->y / (float)*total_height;
+		for (int i = 0; i < n; i++) {
+			fx[i] = (float)ws->x[i] / (float)ws->total_width;
+			fy[i] = (float)ws->y[i] / (float)ws->total_height;
+			ws->mass[i] = (float) ws->width[i] * (float) ws->height[i]
+				/ (float)ws->total_width / (float)ws->total_height;
+		}
+
+		// the overlap tests only ever need the padded sizes
+		int dis = ws->distance / 2;
+		ws->padx = (float)dis / (float) ws->total_width;
+		ws->pady = (float)dis / (float) ws->total_height;
+		for (int i = 0; i < n; i++) {
+			ws->pw[i] = (float)ws->width[i] / (float) ws->total_width + 2*ws->padx;
+			ws->ph[i] = (float)ws->height[i] / (float) ws->total_height + 2*ws->pady;
 		}
 	}
 
+	// broadphase cells sized after the average padded window
+	spatialgrid_t grid;
+	{
+		float sum = 0;
+		for (int i = 0; i < n; i++) {
+			float x0, y0, x1, y1;
+			cosmos_box(ws, i, &x0, &y0, &x1, &y1);
+			sum += (x1 - x0) + (y1 - y0);
+		}
+		grid_init(&grid, MAX(n, 1), MAX(sum / (2 * MAX(n, 1)), 1e-3),
+				ws->direct);
+	}
+
 	// scatter windows with identical centre of mass
 	{
-		srand(0);
 		int iterations = -1;
 		bool colliding = true;
 		while (colliding && iterations <= 1000) {
 			colliding = false;
 
-			for (dlist *iter1 = dlist_first(windows);
-					iter1; iter1=iter1->next) {
-				for (dlist *iter2 = dlist_first(windows);
-						iter2; iter2=iter2->next) {
-					ClientWin *cw1 = iter1->data;
-					ClientWin *cw2 = iter2->data;
-					if (cw1 == cw2)
+			for (int i = 0; i < n; i++)
+				com(ws, i, &ws->cx[i], &ws->cy[i]);
+
+			for (int i = 0; i < n; i++) {
+				if (pinned[i])
+					continue;
+				for (int j = 0; j < n; j++) {
+					if (i == j)
 						continue;
 
-					float x1, y1, x2, y2;
-					com(cw1, &x1, &y1, total_width, total_height);
-					com(cw2, &x2, &y2, total_width, total_height);
-					float dx = x2 - x1;
-					float dy = y2 - y1;
+					float dx = ws->cx[j] - ws->cx[i];
+					float dy = ws->cy[j] - ws->cy[i];
 					float delta = 0.1;
 					if (ABS(dx) <= delta && ABS(dy) <= delta) {
 						colliding = true;
-						float randx = (float)rand()/(float)(RAND_MAX/delta/2) - delta;
-						float randy = (float)rand()/(float)(RAND_MAX/delta/2) - delta;
-						cw1->fx += randx;
-						cw1->fy += randy;
+						float randx = cosmos_rand(ws) * 2 * delta - delta;
+						float randy = cosmos_rand(ws) * 2 * delta - delta;
+						fx[i] += randx;
+						fy[i] += randy;
+						com(ws, i, &ws->cx[i], &ws->cy[i]);
 					}
 				}
 			}
 			iterations++;
+
+			if (budget > 0 && time_in_millis() >= deadline) {
+				timed_out = true;
+				break;
+			}
 		}
-		printfdf(false, "(): %d iterations to resolve identical COM", iterations);
-		printfdf(false, "():");
+		ws->scatter_iterations = iterations;
 	}
 
 	// cosmic expansion
 	{
-		foreach_dlist (dlist_first(windows)) {
-			ClientWin *cw = iter->data;
-			cw->vx = cw->vy = 0;
-		}
+		for (int i = 0; i < n; i++)
+			vx[i] = vy[i] = 0;
 
 		int iterations = 0;
 		float deltat = 1e-1;
-		float aratio = (float)mw->width / (float)mw->height;
-		bool colliding = true;
+		float aratio = (float)ws->screen_width / (float)ws->screen_height;
+		bool colliding = !timed_out;
 		while (colliding && iterations < 1000) {
 			colliding = false;
 
-			for (dlist *iter1 = dlist_first(windows);
-					iter1; iter1=iter1->next) {
-				for (dlist *iter2 = dlist_first(windows);
-						iter2; iter2=iter2->next) {
-					ClientWin *cw1 = iter1->data;
-					ClientWin *cw2 = iter2->data;
-					if (cw1 == cw2)
+			grid_clear(&grid);
+			for (int i = 0; i < n; i++) {
+				float x0, y0, x1, y1;
+				cosmos_box(ws, i, &x0, &y0, &x1, &y1);
+				grid_insert(&grid, i, x0, y0, x1, y1);
+				com(ws, i, &ws->cx[i], &ws->cy[i]);
+			}
+
+			for (int i = 0; i < n; i++) {
+				if (pinned[i])
+					continue;
+				float x0, y0, x1, y1;
+				cosmos_box(ws, i, &x0, &y0, &x1, &y1);
+				int ncandidates = grid_query(&grid, -1, x0, y0, x1, y1);
+				for (int k = 0; k < ncandidates; k++) {
+					int j = grid.candidates[k];
+					if (i == j)
 						continue;
 
-					if (intersectArea(cw1, cw2, total_width, total_height) > 0) {
+					if (cosmos_overlap(ws, i, j)) {
 						colliding = true;
-						float m1 = cw1->src.width * cw1->src.height
-								/ (float)*total_width / (float)*total_height,
-							  m2 = cw2->src.width * cw2->src.height
-								/ (float)*total_width / (float)*total_height;
-						float x1, x2, y1, y2;
-						com(cw1, &x1, &y1, total_width, total_height);
-						com(cw2, &x2, &y2, total_width, total_height);
-						float dx = x2 - x1;
-						float dy = y2 - y1;
-						float vx=0, vy=0;
-						inverse2(dx, dy, &vx, &vy);
-						cw1->vx -= 1e-1 * m2 * vx;
-						cw1->vy -= 1e-1 * m2 * vy / aratio /* * 2.0*/;
-						float speed = sqrt(cw1->vx * cw1->vx + cw1->vy * cw1->vy);
+						float dx = ws->cx[j] - ws->cx[i];
+						float dy = ws->cy[j] - ws->cy[i];
+						float ax=0, ay=0;
+						inverse2(dx, dy, &ax, &ay);
+						vx[i] -= 1e-1 * ws->mass[j] * ax;
+						vy[i] -= 1e-1 * ws->mass[j] * ay / aratio /* * 2.0*/;
+						float speed = sqrt(vx[i] * vx[i] + vy[i] * vy[i]);
 						if (speed > 1) {
-							cw1->vx /= speed;
-							cw1->vy /= speed;
+							vx[i] /= speed;
+							vy[i] /= speed;
 						}
 					}
 				}
 			}
 
-			foreach_dlist (dlist_first(windows)) {
-				ClientWin *cw = iter->data;
-				cw->fx += cw->vx * deltat;
-				cw->fy += cw->vy * deltat;
-				cw->vx = 0;
-				cw->vy = 0;
+			for (int i = 0; i < n; i++) {
+				fx[i] += vx[i] * deltat;
+				fy[i] += vy[i] * deltat;
+				vx[i] = 0;
+				vy[i] = 0;
 			}
-			printfdf(false,"():");
 
 			iterations++;
+
+			if (budget > 0 && colliding && time_in_millis() >= deadline) {
+				timed_out = true;
+				break;
+			}
+		}
+		// nothing moved in the last iteration, free of collisions
+		if (budget > 0 && !colliding && !timed_out) {
+			memcpy(best_fx, fx, n * sizeof(float));
+			memcpy(best_fy, fy, n * sizeof(float));
+			best_extent = cosmos_extent(ws);
 		}
-		printfdf(false, "(): %d expansion iterations", iterations);
-		printfdf(false, "():");
+		ws->expansion_iterations = iterations;
 	}
 
 	// gravitational collapse
 	{
+		// closing the gaps of removed windows takes everyone
+		if (removed) {
+			for (int i = 0; i < n; i++)
+				pinned[i] = false;
+			npinned = 0;
+		}
+
 		int iterations = 0;
 		float deltat = 1e-1;
-		float aratio = (float)mw->width / (float)mw->height;
-		bool stable = false;
-		int dis = mw->distance;
-		float disx = (float) dis / (float) *total_width;
-		float disy = (float) dis / (float) *total_height;
+		float aratio = (float)ws->screen_width / (float)ws->screen_height;
+		bool stable = npinned == n || timed_out;
+		int dis = ws->distance;
+		float disx = (float) dis / (float) ws->total_width;
+		float disy = (float) dis / (float) ws->total_height;
+
+		grid_clear(&grid);
+		for (int i = 0; i < n; i++) {
+			float x0, y0, x1, y1;
+			cosmos_box(ws, i, &x0, &y0, &x1, &y1);
+			grid_insert(&grid, i, x0, y0, x1, y1);
+		}
+
+		// with an opening angle, the attraction of far windows is
+		// approximated through a quadtree
+		float theta = ws->opening_angle;
+		qtree_t tree;
+		if (theta > 0)
+			qtree_init(&tree, n);
+		cosmos_attract_func attract = cosmos_attract_kernel(ws);
+
 		while (!stable && iterations < 10000) {
 			stable = true;
 
-			for (dlist *iter1 = dlist_first(windows);
-					iter1; iter1=iter1->next) {
-				for (dlist *iter2 = dlist_first(windows);
-						iter2; iter2=iter2->next) {
-					ClientWin *cw1 = iter1->data;
-					ClientWin *cw2 = iter2->data;
-					if (cw1 == cw2)
-						continue;
+			// centres of mass move once per iteration,
+			// so they are not worked out again for every pair
+			for (int i = 0; i < n; i++)
+				com(ws, i, &ws->cx[i], &ws->cy[i]);
 
-					float m1 = (float) cw1->src.width * (float) cw1->src.height
-							/ (float)*total_width / (float)*total_height,
-						  m2 = (float) cw2->src.width * (float) cw2->src.height
-							/ (float)*total_width / (float)*total_height;
-					float x1, x2, y1, y2;
-					com(cw1, &x1, &y1, total_width, total_height);
-					com(cw2, &x2, &y2, total_width, total_height);
-					float dx = x2 - x1;
-					float dy = y2 - y1;
-					float vx=0, vy=0;
-					inverse2(dx, dy, &vx, &vy);
-					cw1->vx += 1e-1 * m2 * vx;
-					cw1->vy += 1e-1 * m2 * vy / aratio /* * 2.0*/;
-				}
+			if (theta > 0) {
+				qtree_build(&tree, ws);
+				for (int i = 0; i < n; i++)
+					if (!pinned[i])
+						qtree_attract(&tree, ws, i, theta, aratio);
 			}
+			else
+				attract(ws, 0, aratio);
 
-			foreach_dlist (dlist_first(windows)) {
-				ClientWin *cw1 = iter->data;
-				cw1->fx2 = cw1->fx;
-				cw1->fy2 = cw1->fy;
+			for (int i = 0; i < n; i++) {
+				ws->fx2[i] = fx[i];
+				ws->fy2[i] = fy[i];
+				if (pinned[i])
+					continue;
 
-				float speed = sqrt(cw1->vx * cw1->vx + cw1->vy * cw1->vy);
-				float vx = 0, vy = 0;
+				float speed = sqrt(vx[i] * vx[i] + vy[i] * vy[i]);
+				float stepx = 0, stepy = 0;
 				while (speed > 0) {
-					vx = cw1->vx / speed * disx;
-					vy = cw1->vy / speed * disx;
+					stepx = vx[i] / speed * disx;
+					stepy = vy[i] / speed * disx;
+
+					fx[i] += stepx * deltat;
+					fy[i] += stepy * deltat;
 
-					cw1->fx += vx * deltat;
-					cw1->fy += vy * deltat;
+					// candidates are gathered around the window with a margin,
+					// and gathered again should a push carry it outside
+					float qx0, qy0, qx1, qy1;
+					cosmos_box(ws, i, &qx0, &qy0, &qx1, &qy1);
+					qx0 -= disx; qy0 -= disy;
+					qx1 += disx; qy1 += disy;
+					int ncandidates = grid_query(&grid, -1, qx0, qy0, qx1, qy1);
 
-					for (dlist *iter2 = dlist_first(windows);
-							iter2; iter2=iter2->next) {
-						ClientWin *cw2 = iter2->data;
-						if (cw1 == cw2 || intersectArea(cw1, cw2, total_width, total_height) == 0)
+					for (int k = 0; k < ncandidates; k++) {
+						int j = grid.candidates[k];
+						if (i == j || !cosmos_overlap(ws, i, j))
 							continue;
 
-						float left1 = cw1->fx - disx/2.0;
-						float left2 = cw2->fx - disx/2.0;
-						float right1 = cw1->fx + (float)cw1->src.width / (float)*total_width + disx/2.0;
-						float right2 = cw2->fx + (float)cw2->src.width / (float)*total_width + disx/2.0;
+						float left1 = fx[i] - disx/2.0;
+						float left2 = fx[j] - disx/2.0;
+						float right1 = fx[i] + (float)ws->width[i] / (float)ws->total_width + disx/2.0;
+						float right2 = fx[j] + (float)ws->width[j] / (float)ws->total_width + disx/2.0;
 
-						float top1 = cw1->fy - disy/2.0;
-						float top2 = cw2->fy - disy/2.0;
-						float bottom1 = cw1->fy + (float)cw1->src.height / (float)*total_height + disy/2.0;
-						float bottom2 = cw2->fy + (float)cw2->src.height / (float)*total_height + disy/2.0;
+						float top1 = fy[i] - disy/2.0;
+						float top2 = fy[j] - disy/2.0;
+						float bottom1 = fy[i] + (float)ws->height[i] / (float)ws->total_height + disy/2.0;
+						float bottom2 = fy[j] + (float)ws->height[j] / (float)ws->total_height + disy/2.0;
 
 						float overlapX = fmin(right1, right2) - fmax(left1, left2);
 						float overlapY = fmin(bottom1, bottom2) - fmax(top1, top2);
 
 						if (overlapY < overlapX) {
 							if (top1 < top2)
-								cw1->fy -= overlapY; // push up
+								fy[i] -= overlapY; // push up
 							else
-								cw1->fy += overlapY; // push down
+								fy[i] += overlapY; // push down
 						} else {
 							if (left1 < left2)
-								cw1->fx -= overlapX; // push left
+								fx[i] -= overlapX; // push left
 							else
-								cw1->fx += overlapX; // push right
+								fx[i] += overlapX; // push right
+						}
+
+						float x0, y0, x1, y1;
+						cosmos_box(ws, i, &x0, &y0, &x1, &y1);
+						if (x0 < qx0 || y0 < qy0 || x1 > qx1 || y1 > qy1) {
+							qx0 = x0 - disx; qy0 = y0 - disy;
+							qx1 = x1 + disx; qy1 = y1 + disy;
+							ncandidates = grid_query(&grid, j, qx0, qy0, qx1, qy1);
+							k = -1;
 						}
 					}
 
 					float newspeed = speed - disx;
-					cw1->vx *= newspeed / speed;
-					cw1->vy *= newspeed / speed;
+					vx[i] *= newspeed / speed;
+					vy[i] *= newspeed / speed;
 					speed = newspeed;
 				}
+
+				if (fx[i] != ws->fx2[i] || fy[i] != ws->fy2[i]) {
+					float x0, y0, x1, y1;
+					cosmos_box(ws, i, &x0, &y0, &x1, &y1);
+					grid_remove(&grid, i);
+					grid_insert(&grid, i, x0, y0, x1, y1);
+				}
 			}
 
-			foreach_dlist (dlist_first(windows)) {
-				ClientWin *cw = iter->data;
-				cw->vx = 0;
-				cw->vy = 0;
+			for (int i = 0; i < n; i++) {
+				vx[i] = 0;
+				vy[i] = 0;
 			}
 
-			foreach_dlist (dlist_first(windows)) {
-				ClientWin *cw1 = iter->data;
-				if (ABS(cw1->fx - cw1->fx2) > 0.01 / *total_width
-				 || ABS(cw1->fy - cw1->fy2) > 0.01 / *total_height)
+			for (int i = 0; i < n; i++) {
+				if (ABS(fx[i] - ws->fx2[i]) > 0.01 / ws->total_width
+				 || ABS(fy[i] - ws->fy2[i]) > 0.01 / ws->total_height)
 					stable = false;
 			}
 			iterations++;
+
+			// a stable layout is the result anyway, otherwise the best one
+			// is looked for every few iterations, and on each one once
+			// the deadline draws near
+			if (budget > 0 && !stable) {
+				long now = time_in_millis();
+				if (now >= deadline) {
+					timed_out = true;
+					break;
+				}
+				if (iterations % COSMOS_SNAPSHOT_INTERVAL == 0
+						|| deadline - now <= budget / 10) {
+					float extent = cosmos_extent(ws);
+					if (extent < best_extent && cosmos_collision_free(ws, &grid)) {
+						memcpy(best_fx, fx, n * sizeof(float));
+						memcpy(best_fy, fy, n * sizeof(float));
+						best_extent = extent;
+					}
+				}
+			}
+		}
+		if (theta > 0)
+			qtree_free(&tree);
+		ws->collapse_iterations = iterations;
+	}
+
+	// the best layout of a run out of time is free of collisions already
+	if (!timed_out)
+		ws->separate_iterations = cosmos_separate(ws, &grid);
+
+	grid_free(&grid);
+
+	ws->timed_out = timed_out;
+	if (timed_out) {
+		if (best_extent == INFINITY) {
+			free(best_fx);
+			free(best_fy);
+			free(entries);
+			return false;
 		}
-		printfdf(false, "(): %d collapse iterations", iterations);
-		printfdf(false, "():");
+		memcpy(fx, best_fx, n * sizeof(float));
+		memcpy(fy, best_fy, n * sizeof(float));
 	}
+	free(best_fx);
+	free(best_fy);
+
+	// pinned windows keep their pixel position as is,
+	// so that a run without changes reproduces the previous one
+	for (int i = 0; i < n; i++) {
+		if (pinned[i])
+			continue;
+		ws->x[i] = (float)fx[i] * (float)ws->total_width;
+		ws->y[i] = (float)fy[i] * (float)ws->total_height;
+	}
+
+	// where windows settled, for the next run, unless the run was cut
+	// short: pinning windows to a degraded layout would keep it around
+	if (!timed_out) {
+		for (int i = 0; i < n; i++) {
+			entries[i].x = ws->x[i] + minx;
+			entries[i].y = ws->y[i] + miny;
+		}
+		qsort(entries, n, sizeof(*entries), warm_cmp_wid);
+		free(ws->warm_entries);
+		ws->warm_entries = entries;
+	}
+	else
+		free(entries);
 
 	// calculate final coordinates
 	{
-		int minx = INT_MAX, maxx = INT_MIN;
-		int miny = INT_MAX, maxy = INT_MIN;
-		foreach_dlist (dlist_first(windows)) {
-			ClientWin *cw = iter->data;
-			cw->x = (float)cw->fx * (float)*total_width;
-			cw->y = (float)cw->fy * (float)*total_height;
-
-			minx = MIN(minx, cw->x);
-			maxx = MAX(maxx, cw->x + cw->src.width);
-			miny = MIN(miny, cw->y);
-			maxy = MAX(maxy, cw->y + cw->src.height);
+		minx = INT_MAX, miny = INT_MAX;
+		int maxx = INT_MIN, maxy = INT_MIN;
+		for (int i = 0; i < n; i++) {
+			minx = MIN(minx, ws->x[i]);
+			maxx = MAX(maxx, ws->x[i] + ws->width[i]);
+			miny = MIN(miny, ws->y[i]);
+			maxy = MAX(maxy, ws->y[i] + ws->height[i]);
 		}
 
-		foreach_dlist (dlist_first(windows)) {
-			ClientWin *cw = iter->data;
-			cw->x -= minx;
-			cw->y -= miny;
+		for (int i = 0; i < n; i++) {
+			ws->x[i] -= minx;
+			ws->y[i] -= miny;
 		}
 
-		*total_width = maxx - minx;
-		*total_height = maxy - miny;
+		ws->total_width = maxx - minx;
+		ws->total_height = maxy - miny;
 	}
+
+	return true;
 }
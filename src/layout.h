@@ -20,11 +20,164 @@
 #ifndef SKIPPY_LAYOUT_H
 #define SKIPPY_LAYOUT_H
 
+// where a window settled in a previous cosmos run
+typedef struct {
+	Window wid;
+	// geometry the position was computed for
+	int src_x, src_y, width, height;
+	// converged position, in the same pixel space as the geometry
+	int x, y;
+} layout_warm_entry_t;
+
+// converged cosmos positions of the previous run, sorted by window id
+struct _layout_warm_t {
+	int n;
+	layout_warm_entry_t *entries;
+	int distance;
+	int screen_width, screen_height;
+};
+
+#define LAYOUT_CACHE_SIZE 8
+
+// a window as far as the layout is concerned
+typedef struct {
+	Window wid;
+	// source geometry, virtual desktop offset included
+	int x, y, width, height;
+	// position in the stacking order, for the layouts that care
+	int rank;
+	int hidden;
+} layout_key_window_t;
+
+// everything a layout result depends on
+typedef struct {
+	uint64_t hash;
+	int mode, algorithm;
+	int screen_width, screen_height, distance;
+	long desktop;
+	bool one_row;
+	int one_row_items;
+	int n;
+	// sorted by window id
+	layout_key_window_t *windows;
+} layout_cache_key_t;
+
+typedef struct {
+	layout_cache_key_t key;
+	// destination coordinates, in the order of key.windows
+	int *x, *y;
+	unsigned int total_width, total_height;
+	unsigned long stamp;
+} layout_cache_entry_t;
+
+// recently computed layouts, least recently used ones evicted first
+struct _layout_cache_t {
+	layout_cache_entry_t entries[LAYOUT_CACHE_SIZE];
+	unsigned long clock;
+	unsigned long hits, misses;
+};
+
+// packed copy of the geometry the layout algorithms work on,
+// all arrays are indexed by the window's position in the workspace
+typedef struct {
+	int n;
+	ClientWin **cw;
+	Window *wid;
+	int *width, *height;
+	// destination coordinates, in pixels
+	int *x, *y;
+	// windows xd leaves in place
+	bool *hidden;
+	// cosmos state, normalized by total width/height
+	float *fx, *fy, *fx2, *fy2;
+	float *vx, *vy;
+	float *mass;
+	// centres of mass, and sizes padded by half the distance
+	float *cx, *cy;
+	float *pw, *ph;
+	float padx, pady;
+	// windows seeded from the warm table, left out of the physics
+	bool *pinned;
+	// previous run to start from, may be NULL
+	const layout_warm_t *warm;
+	// where this run's windows settled, sorted by window id,
+	// for layout_warm_update() to keep
+	layout_warm_entry_t *warm_entries;
+	int npinned;
+	// some windows of the previous run are gone
+	bool warm_removed;
+	// state of the scatter's random generator, seeded per workspace
+	uint64_t seed;
+
+	int distance;
+	int screen_width, screen_height;
+	unsigned int total_width, total_height;
+
+	// test every pair of windows, without the broadphase grid
+	bool direct;
+	// sum the attractions without the vector kernels
+	bool scalar;
+
+	// options, copied so that a worker thread needs no session
+	bool one_row;
+	int one_row_items;
+	int time_budget;
+	float opening_angle;
+
+	// iterations the cosmos phases took
+	int scatter_iterations, expansion_iterations, collapse_iterations;
+	int separate_iterations;
+	// cosmos ran out of time, the layout is the best one found so far
+	bool timed_out;
+} layout_ws_t;
+
+// fewest windows for which cosmos uses the broadphase grid;
+// below it, keeping the grid up to date costs more than testing
+// every pair, so queries simply return all later windows
+#define GRID_MIN_WINDOWS 100
+
+// a layout computed from a snapshot of the windows,
+// possibly on a worker thread
+struct _layout_job_t {
+	MainWin *mw;
+	// workspaces to lay out, cosmos falling back to xd
+	bool cosmos, xd;
+	layout_ws_t cosmos_ws, xd_ws;
+	bool threaded;
+	pthread_t thread;
+	// what the result is cached under, windows in the order of the key
+	layout_cache_t *cache;
+	layout_cache_key_t key;
+	ClientWin **cws;
+	bool cached;
+	// workspace holding the result, if any
+	layout_ws_t *result;
+	unsigned int total_width, total_height;
+};
+
+// fill a workspace from the windows, in list order
+void layout_ws_init(layout_ws_t *ws, MainWin *mw, dlist *windows);
+// copy the destination coordinates back to the windows
+void layout_ws_apply(layout_ws_t *ws);
+void layout_ws_free(layout_ws_t *ws);
+void layout_warm_free(layout_warm_t *warm);
+// keep where the windows of a cosmos run settled for the next one,
+// taking over the workspace's entries
+void layout_warm_update(layout_warm_t **warm, layout_ws_t *ws);
+void layout_cache_free(layout_cache_t *cache);
+
 // calculate and populate windows destination positions
 // switches to different layout algorithms based on user/default config
 void layout_run(MainWin *, dlist *, unsigned int *, unsigned int *, enum layoutmode);
-void layout_xd(MainWin *, dlist *, unsigned int *, unsigned int *);
-void layout_cosmos(MainWin *, dlist *, unsigned int *, unsigned int *);
+// snapshot the windows and lay them out, on a worker thread if threaded,
+// the desktop offsets and cache lookup happening right away
+layout_job_t *layout_job_start(MainWin *, dlist *windows, bool threaded);
+// wait for the layout and apply it to the windows, which must all still
+// exist, totals left as they are when there is no layout to apply
+void layout_job_finish(layout_job_t *, unsigned int *total_width, unsigned int *total_height);
+void layout_xd(MainWin *, layout_ws_t *);
+// false when the time budget ran out before any layout without collisions
+bool layout_cosmos(MainWin *, layout_ws_t *);
 
 int middleOfThree(int a, int b, int c);
 
@@ -46,6 +46,16 @@ find_argb_visual (Display *dpy, int scr)
 	return visual;
 }
 
+static void
+maskcache_free_pixmap(session_t *ps, XID mask) {
+	XFreePixmap(ps->dpy, mask);
+}
+
+static void
+maskcache_free_picture(session_t *ps, XID mask) {
+	XRenderFreePicture(ps->dpy, mask);
+}
+
 MainWin *
 mainwin_create(session_t *ps) {
 	Display * const dpy = ps->dpy;
@@ -70,8 +80,14 @@ mainwin_create(session_t *ps) {
 	// mw->pressed = mw->focus = 0;
 	mw->pressed = mw->client_to_focus = 0;
 	mw->clientondesktop = 0;
-	mw->focuslist = 0;
 	mw->refocus = false;
+	mw->clients_by_wid = winmap_create();
+	mw->clients_by_src = winmap_create();
+	mw->clients_by_mini = winmap_create();
+	mw->stack_set = winmap_create();
+	mw->stack_set_next = winmap_create();
+	mw->shape_masks.free_func = maskcache_free_pixmap;
+	mw->alpha_masks.free_func = maskcache_free_picture;
 
 	XWindowAttributes rootattr;
 	XGetWindowAttributes(dpy, ps->root, &rootattr);
@@ -120,8 +136,14 @@ mainwin_create(session_t *ps) {
 	return mw;
 
 mainwin_create_err:
-	if (mw)
+	if (mw) {
+		winmap_destroy(mw->clients_by_wid);
+		winmap_destroy(mw->clients_by_src);
+		winmap_destroy(mw->clients_by_mini);
+		winmap_destroy(mw->stack_set);
+		winmap_destroy(mw->stack_set_next);
 		free(mw);
+	}
 	return NULL;
 }
 
@@ -225,6 +247,10 @@ mainwin_reload(session_t *ps, MainWin *mw) {
 
 	mw->distance = ps->o.distance;
 
+	// the corner radius may have changed
+	maskcache_clear(ps, &mw->shape_masks);
+	maskcache_clear(ps, &mw->alpha_masks);
+
 	if (ps->o.updatetooltip) {
 		foreach_dlist (mw->clients) {
 			ClientWin *cw = (ClientWin *) iter->data;
@@ -431,11 +457,29 @@ void
 mainwin_destroy(MainWin *mw) {
 	session_t *ps = mw->ps; 
 
+	if (mw->layout_job) {
+		unsigned int width = 0, height = 0;
+		layout_job_finish(mw->layout_job, &width, &height);
+		mw->layout_job = NULL;
+	}
+
 	// Free all clients associated with this main window
 	dlist_free_with_func(mw->clients, (dlist_free_func) clientwin_destroy);
 
 	dlist_free(mw->clientondesktop);
 	dlist_free(mw->panels);
+	cwvec_free(&mw->focuslist);
+	cwvec_free(&mw->dirty);
+	layout_warm_free(mw->cosmos_warm);
+	layout_cache_free(mw->layout_cache);
+	winmap_destroy(mw->clients_by_wid);
+	winmap_destroy(mw->clients_by_src);
+	winmap_destroy(mw->clients_by_mini);
+	winmap_destroy(mw->stack_set);
+	winmap_destroy(mw->stack_set_next);
+	free(mw->stack);
+	maskcache_clear(ps, &mw->shape_masks);
+	maskcache_clear(ps, &mw->alpha_masks);
 
 	if(mw->background != None)
 		XRenderFreePicture(ps->dpy, mw->background);
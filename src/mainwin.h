@@ -39,6 +39,19 @@ struct _mainwin_t {
 	int x, y, xoff, yoff;
 	int width, height, distance;
 	float multiplier;
+	/// @brief Cosmos solution of the previous activation.
+	layout_warm_t *cosmos_warm;
+	/// @brief Layouts of recent activations.
+	layout_cache_t *layout_cache;
+	/// @brief Layout still being computed, if any.
+	layout_job_t *layout_job;
+	/// @brief ClientWins by client window, frame window and mini window.
+	winmap_t *clients_by_wid, *clients_by_src, *clients_by_mini;
+	/// @brief Window stack the clients were last reconciled with.
+	Window *stack;
+	int nstack;
+	/// @brief Windows of mw->stack, and of the stack being reconciled.
+	winmap_t *stack_set, *stack_set_next;
 
 	XRenderPictFormat *format;
 	XTransform transform, desktoptransform;
@@ -49,7 +62,15 @@ struct _mainwin_t {
 	Picture normalPicture, shadowPicture;
 	
 	ClientWin *pressed, *focus;
-	dlist *clientondesktop, *focuslist, *desktopwins, *dminis, *panels;
+	dlist *clientondesktop, *desktopwins, *dminis, *panels;
+	/// @brief Windows in the order of cycling through them.
+	cwvec_t focuslist;
+	/// @brief Clients with changes to apply while idle, each once.
+	cwvec_t dirty;
+	/// @brief Bounding shape masks of mini windows, by size and radius.
+	maskcache_t shape_masks;
+	/// @brief A8 pictures of XRoundedRectMaskCached(), by size and radius.
+	maskcache_t alpha_masks;
 	
 	KeySym *keysyms_Up;
 	KeySym *keysyms_Down;
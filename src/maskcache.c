@@ -0,0 +1,60 @@
+/* Skippy-xd
+ *
+ * Copyright (C) 2004 Hyriand <hyriand@thegraveyard.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "skippy.h"
+
+XID
+maskcache_get(maskcache_t *c, int width, int height, int radius) {
+	for (int i = 0; i < c->len; i++) {
+		maskcache_entry_t *e = &c->entries[i];
+		if (e->width == width && e->height == height && e->radius == radius) {
+			e->used = ++c->clock;
+			return e->mask;
+		}
+	}
+
+	return None;
+}
+
+void
+maskcache_put(session_t *ps, maskcache_t *c,
+		int width, int height, int radius, XID mask) {
+	maskcache_entry_t *e = NULL;
+	if (c->len < MASKCACHE_SIZE)
+		e = &c->entries[c->len++];
+	else {
+		e = &c->entries[0];
+		for (int i = 1; i < c->len; i++)
+			if (c->entries[i].used < e->used)
+				e = &c->entries[i];
+		c->free_func(ps, e->mask);
+	}
+
+	*e = (maskcache_entry_t) {
+		.width = width, .height = height, .radius = radius,
+		.mask = mask, .used = ++c->clock,
+	};
+}
+
+void
+maskcache_clear(session_t *ps, maskcache_t *c) {
+	for (int i = 0; i < c->len; i++)
+		c->free_func(ps, c->entries[i].mask);
+	c->len = 0;
+}
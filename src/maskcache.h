@@ -0,0 +1,54 @@
+/* Skippy-xd
+ *
+ * Copyright (C) 2004 Hyriand <hyriand@thegraveyard.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SKIPPY_MASKCACHE_H
+#define SKIPPY_MASKCACHE_H
+
+// small LRU of server-side masks, keyed by their size and corner radius
+
+#define MASKCACHE_SIZE 32
+
+typedef void (*maskcache_free_func)(session_t *ps, XID mask);
+
+typedef struct {
+	int width, height, radius;
+	XID mask;
+	// clock value of the last lookup that found it
+	unsigned long used;
+} maskcache_entry_t;
+
+typedef struct {
+	// frees the masks the cache drops
+	maskcache_free_func free_func;
+	maskcache_entry_t entries[MASKCACHE_SIZE];
+	int len;
+	unsigned long clock;
+} maskcache_t;
+
+/* the mask cached for the key, or None */
+XID maskcache_get(maskcache_t *c, int width, int height, int radius);
+
+/* cache mask for the key, dropping the least recently used mask if full */
+void maskcache_put(session_t *ps, maskcache_t *c,
+		int width, int height, int radius, XID mask);
+
+/* drop all masks */
+void maskcache_clear(session_t *ps, maskcache_t *c);
+
+#endif /* SKIPPY_MASKCACHE_H */
@@ -94,6 +94,25 @@ Picture XRoundedRectMask(session_t *ps,
 	return mask;
 }
 
+/**
+ * XRoundedRectMask() through the LRU of the main window, so that
+ * repaints of the same size composite with a mask drawn only once. The
+ * picture belongs to the cache and must not be freed.
+ */
+Picture XRoundedRectMaskCached(session_t *ps,
+		int w, int h,
+		int radius)
+{
+	maskcache_t *masks = &ps->mainwin->alpha_masks;
+	Picture mask = maskcache_get(masks, w, h, radius);
+	if (!mask) {
+		mask = XRoundedRectMask(ps, w, h, radius, NULL);
+		maskcache_put(ps, masks, w, h, radius, mask);
+	}
+
+	return mask;
+}
+
 void XRoundedRectComposite(session_t *ps,
 		Picture src,
 		Picture dst,
@@ -111,15 +130,11 @@ void XRoundedRectComposite(session_t *ps,
 				dst_x, dst_y,
 				w, h);
 
-	Pixmap pm;
-	Picture mask = XRoundedRectMask(ps, w, h, radius, &pm);
+	Picture mask = XRoundedRectMaskCached(ps, w, h, radius);
 
 	XRenderComposite(ps->dpy, PictOpOver,
 			src, mask, dst,
 			src_x, src_y, 0, 0, dst_x, dst_y, w, h);
-
-    XRenderFreePicture(ps->dpy, mask);
-    XFreePixmap(ps->dpy, pm);
 }
 
 /**
@@ -808,65 +823,272 @@ anime(
 		ClientWin *cw = (ClientWin *) iter->data;
 		clientwin_move(cw, multiplier, mw->xoff, mw->yoff, timeslice);
 		clientwin_update2(cw);
-		clientwin_map(cw);
+		clientwin_animate(cw, timeslice >= 1);
+	}
+}
+
+// once the first frame drawn from the snapshots is on screen, rebuild
+// the pictures skippy_activate() left alone and repaint from the clients
+static void
+leave_snapshots(MainWin *mw)
+{
+	bool flushed = false;
+	foreach_dlist (mw->clients) {
+		ClientWin *cw = iter->data;
+		if (!cw->from_snapshot)
+			continue;
+		if (!flushed)
+			XFlush(mw->ps->dpy);
+		flushed = true;
+		clientwin_live(cw);
+	}
+}
+
+// XNextEvent(), dropping the cached window properties and frames an
+// event changes, following the geometry of the clients and collecting
+// their damage
+static void
+next_event(session_t *ps, XEvent *ev)
+{
+	XNextEvent(ps->dpy, ev);
+	if (ev->type == PropertyNotify)
+		wm_props_invalidate(ps, ev->xproperty.window, ev->xproperty.atom);
+	else if (ps->xinfo.damage_ev_base + XDamageNotify == ev->type) {
+		XDamageNotifyEvent *dev = (XDamageNotifyEvent *) ev;
+		ClientWin *cw = ps->mainwin ? clientwin_find(ps->mainwin, dev->drawable): NULL;
+		if (cw && dev->damage == cw->snapshot_damage)
+			cw->snapshot_stale = true;
+		else if (cw)
+			clientwin_schedule_repair(cw, &dev->area);
+	}
+	else {
+		wm_frames_track(ps, ev);
+		if (ps->mainwin)
+			clientwin_track(ps->mainwin, ev);
 	}
 }
 
+// note what an idle ConfigureNotify, UnmapNotify or PropertyNotify
+// changed of its client, adding the client to the dirty set
+static void
+mark_dirty(MainWin *mw, const XEvent *ev)
+{
+	ClientWin *cw = clientwin_find(mw, ev_window(mw->ps, ev));
+	if (!cw)
+		return;
+
+	unsigned flags = 0;
+	if (ev->type != PropertyNotify)
+		flags = CW_DIRTY_GEOMETRY;
+	else if (ev->xproperty.atom == _NET_WM_ICON)
+		flags = CW_DIRTY_ICON;
+	else if (ev->xproperty.atom == _NET_WM_STATE)
+		flags = CW_DIRTY_STATE;
+	if (!flags)
+		return;
+
+	if (!cw->dirty)
+		cwvec_push(&mw->dirty, cw);
+	cw->dirty |= flags;
+}
+
+// bring every client of the dirty set up to date, each once
+static void
+flush_dirty(MainWin *mw)
+{
+	for (int i = 0; i < mw->dirty.len; i++) {
+		ClientWin *cw = mw->dirty.data[i];
+		if (cw->dirty & CW_DIRTY_ICON)
+			cw->icon_tried = false; /* force reload on next real update */
+		if (cw->dirty & (CW_DIRTY_GEOMETRY | CW_DIRTY_STATE)) {
+			if (clientwin_detect_change(cw)) {
+				clientwin_update(cw);
+				clientwin_update3(cw);
+				clientwin_update2(cw);
+			}
+			else {
+				printfdf(false, "(): no effective change detected for %#010lx, skipping updates", cw->wid_client);
+			}
+		}
+		cw->dirty = 0;
+	}
+	mw->dirty.len = 0;
+}
+
+// XSync() and read every queued event through next_event(), as idle
+// events, so the caches it keeps see them before they are dropped
+static void
+drain_events(session_t *ps)
+{
+	XEvent ev = { };
+
+	XSync(ps->dpy, False);
+	while (XEventsQueued(ps->dpy, QueuedAfterReading)) {
+		next_event(ps, &ev);
+		if (ev.type == ConfigureNotify || ev.type == PropertyNotify
+				|| ev.type == UnmapNotify)
+			mark_dirty(ps->mainwin, &ev);
+	}
+	flush_dirty(ps->mainwin);
+}
+
+// snapshots taken per round while idle, and the time between rounds
+#define SNAPSHOT_BATCH 4
+#define SNAPSHOT_INTERVAL 250
+
+// take up to max of the idle snapshots that are due, at the scale of
+// the last layout, returning whether more are due
+static bool
+refresh_snapshots(MainWin *mw, int max)
+{
+	float scale = mw->multiplier > 0 && mw->multiplier < 1 ? mw->multiplier: 0.5;
+	bool due = false;
+
+	foreach_dlist (mw->clients) {
+		ClientWin *cw = (ClientWin *) iter->data;
+		if (!clientwin_snapshot_due(cw, scale))
+			continue;
+		if (max-- <= 0) {
+			due = true;
+			break;
+		}
+		clientwin_snapshot(cw, scale);
+	}
+
+	return due;
+}
+
+// the ClientWin behind a mini window of the current layout: a desktop
+// in paging mode, otherwise a client other than a panel
+static ClientWin *
+find_layout_mini(MainWin *mw, enum layoutmode layout, Window wid)
+{
+	ClientWin *cw = clientwin_find_mini(mw, wid);
+	if (!cw)
+		return NULL;
+	if (layout == LAYOUTMODE_PAGING)
+		return cw->mode == CLIDISP_DESKTOP ? cw: NULL;
+	return cw->mode != CLIDISP_DESKTOP && cw->paneltype == WINTYPE_WINDOW ? cw: NULL;
+}
+
 static void
 count_clients(MainWin *mw)
 {
 	// Update the list of windows with correct z-ordering
-	dlist *stack = dlist_first(wm_get_stack(mw->ps));
+	int nstack = 0;
+	Window *wids = wm_get_stack(mw->ps, &nstack);
 	mw->clients = dlist_first(mw->clients);
 
-	// Terminate mw->clients that are no longer managed
-	for (dlist *iter = mw->clients; iter; ) {
-		ClientWin *cw = (ClientWin *) iter->data;
-		if (dlist_find_data(stack, (void *) cw->wid_client)) {
-			iter = iter->next;
+	// Nothing to reconcile when the stack is the one of last time
+	if (nstack == mw->nstack && mw->stack
+			&& !memcmp(wids, mw->stack, nstack * sizeof(Window))) {
+		free(wids);
+		return;
+	}
+
+	// mw->stack_set holds the windows of mw->stack, if it is still valid
+	winmap_t *instack = mw->stack_set_next;
+	winmap_clear(instack);
+	for (int i = 0; i < nstack; i++)
+		winmap_set(instack, wids[i], mw);
+
+	// Terminate mw->clients that are no longer managed:
+	// the windows that left the stack, or all of them without a stack.
+	// A window may leave the stack and live on, so its damage objects and
+	// event selection are released as well; xerror() only logs the errors
+	// this raises for a window already destroyed.
+	if (mw->stack) {
+		for (int i = 0; i < mw->nstack; i++) {
+			if (winmap_get(instack, mw->stack[i]))
+				continue;
+			ClientWin *cw = clientwin_find(mw, mw->stack[i]);
+			if (!cw || winmap_get(instack, cw->wid_client))
+				continue;
+			dlist *del = dlist_find_data(mw->clients, cw);
+			if (del)
+				mw->clients = dlist_first(dlist_remove(del));
+			clientwin_destroy(cw, False);
 		}
-		else {
-			dlist *tmp = iter->next;
-			clientwin_destroy((ClientWin *) iter->data, True);
-			mw->clients = dlist_remove(iter);
-			iter = tmp;
+	}
+	else {
+		for (dlist *iter = mw->clients; iter; ) {
+			ClientWin *cw = (ClientWin *) iter->data;
+			if (winmap_get(instack, cw->wid_client)) {
+				iter = iter->next;
+			}
+			else {
+				dlist *tmp = iter->next;
+				clientwin_destroy(cw, False);
+				mw->clients = dlist_remove(iter);
+				iter = tmp;
+			}
 		}
+		mw->clients = dlist_first(mw->clients);
 	}
 	XFlush(mw->ps->dpy);
 
-	// Add new mw->clients
-	// This algorithm preserves correct z-order:
-	// stack is ordered by correct z-order
-	// and we re-order existing or new ClientWin to match that in stack
-	// yes, it is O(n^2) complexity
-	dlist *new_clients = NULL;
-
-	foreach_dlist (stack) {
-		dlist *insert_point = dlist_find(mw->clients, clientwin_cmp_func, iter->data);
-		if (!insert_point && ((Window) iter->data) != mw->window) {
-			ClientWin *cw = clientwin_create(mw, (Window)iter->data);
-			if (!cw) continue;
-			new_clients = dlist_add(new_clients, cw);
+	// Add new mw->clients: only windows that were not in the stack
+	bool complete = true;
+	dlist *tail = dlist_last(mw->clients);
+	for (int i = 0; i < nstack; i++) {
+		if (wids[i] == mw->window
+				|| (mw->stack && winmap_get(mw->stack_set, wids[i]))
+				|| clientwin_find(mw, wids[i]))
+			continue;
+		ClientWin *cw = clientwin_create(mw, wids[i]);
+		if (!cw) {
+			complete = false;
+			continue;
 		}
-		else {
-			ClientWin *cw = (ClientWin *) insert_point->data;
-			new_clients = dlist_add(new_clients, cw);
+		tail = dlist_add(tail, cw);
+		if (!mw->clients)
+			mw->clients = tail;
+	}
+
+	// This preserves correct z-order:
+	// stack is ordered by correct z-order
+	// and we re-order the ClientWins in place to match that in stack
+	{
+		dlist *node = mw->clients;
+		for (int i = 0; i < nstack && node; i++) {
+			ClientWin *cw = wids[i] == mw->window ? NULL:
+				clientwin_find(mw, wids[i]);
+			if (cw) {
+				node->data = cw;
+				node = node->next;
+			}
 		}
 	}
 
-	dlist_free(stack);
-	dlist_free(mw->clients);
-	mw->clients = dlist_first(new_clients);
+	// a window that could not be added is retried next time
+	free(mw->stack);
+	mw->stack = complete ? wids: NULL;
+	mw->nstack = complete ? nstack: 0;
+	if (!complete)
+		free(wids);
+	mw->stack_set_next = mw->stack_set;
+	mw->stack_set = instack;
 }
 
 static void
 count_and_filter_clients(MainWin *mw)
 {
+	session_t *ps = mw->ps;
+
 	count_clients(mw);
 
-	foreach_dlist (mw->clients) {
-		ClientWin *cw = iter->data;
-		clientwin_update(cw);
+	clientwin_update_all(mw, mw->clients);
+
+	// properties the filters and tooltips below are going to ask for
+	{
+		unsigned which = WM_PROP_TYPE | WM_PROP_DESKTOP;
+		if (WMPSN_EWMH == ps->wmpsn)
+			which |= WM_PROP_STATE;
+		if (ps->o.wm_class || (ps->o.tooltip_show && ps->o.tooltip_option != 0))
+			which |= WM_PROP_CLASS;
+		if (ps->o.wm_title || (ps->o.tooltip_show && ps->o.tooltip_option == 0))
+			which |= WM_PROP_TITLE;
+		wm_props_prefetch(ps, mw->clients, which);
 	}
 
 	// update mw->clientondesktop
@@ -902,42 +1124,58 @@ count_and_filter_clients(MainWin *mw)
 	return;
 }
 
+// order the focus list by the grid cell each window falls in,
+// the cells being the size of the smallest window
+static void
+focuslist_sort_by_column(MainWin *mw) {
+	cwvec_t *focuslist = &mw->focuslist;
+	int tile[2] = { INT_MAX, INT_MAX };
+	for (int i = 0; i < focuslist->len; i++) {
+		tile[0] = MIN(tile[0], focuslist->data[i]->src.width);
+		tile[1] = MIN(tile[1], focuslist->data[i]->src.height);
+	}
+	tile[0] = MAX(tile[0], 1);
+	tile[1] = MAX(tile[1], 1);
+	cwvec_sort(focuslist, cw_cmp_by_column, tile);
+}
+
 static void
 init_focus(MainWin *mw, enum layoutmode layout, Window leader) {
 	session_t *ps = mw->ps;
 
 	// ordering of client windows list
 	// is important for prev/next window selection
-	mw->focuslist = dlist_dup(mw->clientondesktop);
+	cwvec_from_dlist(&mw->focuslist, mw->clientondesktop);
 
 	if (layout == LAYOUTMODE_EXPOSE && ps->o.exposeLayout != LAYOUT_XD)
-		dlist_sort(mw->focuslist, sort_cw_by_column, 0);
+		focuslist_sort_by_column(mw);
 	else
-		dlist_reverse(mw->focuslist);
+		cwvec_reverse(&mw->focuslist);
+	focuslist_reindex(&mw->focuslist);
 
-	dlist *iter = dlist_find(mw->focuslist, clientwin_cmp_func, (void *) leader);
+	ClientWin *leader_cw = leader ? clientwin_find(mw, leader): NULL;
+	int leader_index = leader_cw ?
+		focuslist_index_of(&mw->focuslist, leader_cw): -1;
 
-	if (iter) {
-		mw->client_to_focus_on_cancel = (ClientWin *) iter->data;
-		mw->focuslist = dlist_cycle(mw->focuslist,
-				dlist_index_of(mw->focuslist, iter));
-		if (ps->o.focus_initial != 0 && iter)
+	if (leader_index >= 0) {
+		mw->client_to_focus_on_cancel = mw->focuslist.data[leader_index];
+		cwvec_rotate(&mw->focuslist, leader_index);
+		if (ps->o.focus_initial != 0)
 		{
 			if (ps->o.focus_initial < 0)
-				ps->o.focus_initial = ps->o.focus_initial % dlist_len(mw->focuslist);
+				ps->o.focus_initial = ps->o.focus_initial % mw->focuslist.len;
 
-			mw->focuslist = dlist_cycle(mw->focuslist, ps->o.focus_initial);
+			cwvec_rotate(&mw->focuslist, ps->o.focus_initial);
 		}
 	}
 	else {
 		mw->client_to_focus_on_cancel = NULL;
 	}
 
-	dlist *first = dlist_first(mw->focuslist);
-	if (first) {
-		mw->client_to_focus = first->data;
+	if (mw->focuslist.len) {
+		mw->client_to_focus = mw->focuslist.data[0];
 		mw->client_to_focus->focused = 1;
-		if (iter && !mw->mapped &&
+		if (leader_index >= 0 && !mw->mapped &&
 				(ps->o.switchCycleDuringWait || ps->o.switchWaitDuration == 0)) {
 			Window wid = mw->client_to_focus->wid_client;
 			XRaiseWindow(ps->dpy, wid);
@@ -946,8 +1184,11 @@ init_focus(MainWin *mw, enum layoutmode layout, Window leader) {
 		}
 	}
 
-	if (layout == LAYOUTMODE_SWITCH && ps->o.switchLayout == LAYOUT_COSMOS)
-		dlist_sort(mw->focuslist, sort_cw_by_column, 0);
+	// with the layout still running, finish_layout() sorts them
+	if (layout == LAYOUTMODE_SWITCH && ps->o.switchLayout == LAYOUT_COSMOS
+			&& !mw->layout_job)
+		focuslist_sort_by_column(mw);
+	focuslist_reindex(&mw->focuslist);
 }
 
 static void
@@ -998,12 +1239,15 @@ calculatePanelBorders(MainWin *mw,
 	printfdf(false,"(): panel framing calculations: (%d,%d) (%d,%d)", *x1, *y1, *x2, *y2);
 }
 
-static bool
-init_layout(MainWin *mw, enum layoutmode layout, Window leader)
+// pick up the layout and scale it to the screen
+static void
+place_layout(MainWin *mw)
 {
 	unsigned int newwidth = 100, newheight = 100;
-	if (mw->clientondesktop)
-		layout_run(mw, mw->clientondesktop, &newwidth, &newheight, layout);
+	if (mw->layout_job) {
+		layout_job_finish(mw->layout_job, &newwidth, &newheight);
+		mw->layout_job = NULL;
+	}
 
 	int x1=0, y1=0, x2=0, y2=0;
 	calculatePanelBorders(mw, &x1, &y1, &x2, &y2);
@@ -1026,6 +1270,21 @@ init_layout(MainWin *mw, enum layoutmode layout, Window leader)
 	mw->multiplier = multiplier;
 	mw->xoff = xoff + x1;
 	mw->yoff = yoff + y1;
+}
+
+static bool
+init_layout(MainWin *mw, enum layoutmode layout, Window leader)
+{
+	// nothing shows during switchWaitDuration,
+	// so the layout is computed on a worker thread meanwhile
+	bool threaded = layout == LAYOUTMODE_SWITCH && mw->ps->o.switchWaitDuration > 0;
+	if (mw->clientondesktop)
+		mw->layout_job = layout_job_start(mw, mw->clientondesktop, threaded);
+
+	// a layout on the worker is placed once the wait is over,
+	// anything else, no layout included, right away
+	if (!threaded || !mw->layout_job)
+		place_layout(mw);
 
 	init_focus(mw, layout, leader);
 
@@ -1210,7 +1469,8 @@ init_paging_layout(MainWin *mw, enum layoutmode layout, Window leader)
 		}
 	}
 
-	mw->focuslist = dlist_dup(mw->dminis);
+	cwvec_from_dlist(&mw->focuslist, mw->dminis);
+	focuslist_reindex(&mw->focuslist);
 
 	return true;
 }
@@ -1259,6 +1519,48 @@ desktopwin_map(ClientWin *cw)
 		clientwin_tooltip(cw);
 }
 
+// the part of the activation that needs the windows laid out
+static void
+finish_activate(MainWin *mw)
+{
+	foreach_dlist(mw->clients) {
+		ClientWin *cw = iter->data;
+		cw->src.x -= mw->x;
+		cw->src.y -= mw->y;
+		cw->x *= mw->multiplier;
+		cw->y *= mw->multiplier;
+		cw->paneltype = WINTYPE_WINDOW;
+	}
+
+	foreach_dlist(mw->panels) {
+		ClientWin *cw = iter->data;
+		cw->factor = 1;
+		cw->paneltype = wm_identify_panel(mw->ps, cw->wid_client);
+		if (!mw->ps->o.pseudoTrans) {
+			cw->src.x += mw->x;
+			cw->src.y += mw->y;
+		}
+		if (cw->paneltype == WINTYPE_DESKTOP)
+			clientwin_move(cw, 1, cw->src.x, cw->src.y, 1);
+	}
+}
+
+// wait for a layout still being computed and finish the activation,
+// to be done before showing anything or touching the client lists
+static void
+finish_layout(MainWin *mw, enum layoutmode layout)
+{
+	if (!mw->layout_job)
+		return;
+
+	place_layout(mw);
+	if (layout == LAYOUTMODE_SWITCH && mw->ps->o.switchLayout == LAYOUT_COSMOS) {
+		focuslist_sort_by_column(mw);
+		focuslist_reindex(&mw->focuslist);
+	}
+	finish_activate(mw);
+}
+
 static bool
 skippy_activate(MainWin *mw, enum layoutmode layout, Window leader)
 {
@@ -1267,11 +1569,16 @@ skippy_activate(MainWin *mw, enum layoutmode layout, Window leader)
 
 	mw->client_to_focus = NULL;
 
+	// geometries already came in with clientwin_update_all()
 	count_and_filter_clients(mw);
 	foreach_dlist(mw->clients) {
-		clientwin_update((ClientWin *) iter->data);
-		clientwin_update3((ClientWin *) iter->data);
-		clientwin_update2((ClientWin *) iter->data);
+		ClientWin *cw = iter->data;
+		// a current snapshot draws the first frame, the pictures are
+		// rebuilt once it is on screen, see leave_snapshots()
+		cw->from_snapshot = clientwin_snapshot_current(cw);
+		if (!cw->from_snapshot)
+			clientwin_update3(cw);
+		clientwin_update2(cw);
 	}
 
 #ifdef CFG_XINERAMA
@@ -1310,26 +1617,9 @@ skippy_activate(MainWin *mw, enum layoutmode layout, Window leader)
 		}
 	}
 
-	foreach_dlist(mw->clients) {
-		ClientWin *cw = iter->data;
-		cw->src.x -= mw->x;
-		cw->src.y -= mw->y;
-		cw->x *= mw->multiplier;
-		cw->y *= mw->multiplier;
-		cw->paneltype = WINTYPE_WINDOW;
-	}
-
-	foreach_dlist(mw->panels) {
-		ClientWin *cw = iter->data;
-		cw->factor = 1;
-		cw->paneltype = wm_identify_panel(mw->ps, cw->wid_client);
-		if (!mw->ps->o.pseudoTrans) {
-			cw->src.x += mw->x;
-			cw->src.y += mw->y;
-		}
-		if (cw->paneltype == WINTYPE_DESKTOP)
-			clientwin_move(cw, 1, cw->src.x, cw->src.y, 1);
-	}
+	// otherwise the worker's layout is picked up by finish_layout()
+	if (!mw->layout_job)
+		finish_activate(mw);
 
 	return true;
 }
@@ -1351,6 +1641,7 @@ mainloop(session_t *ps, bool activate_on_start) {
 	bool focus_stolen = false;
 	Window leader = 0;
 	bool switchdesktop = false;
+	long last_snapshots = 0L;
 
 	switch (ps->o.mode) {
 		case PROGMODE_SWITCH:
@@ -1395,6 +1686,9 @@ mainloop(session_t *ps, bool activate_on_start) {
 		if (!mw && activate) {
 			assert(ps->mainwin);
 			activate = false;
+			// activation runs before the queue is read: apply what the
+			// server sent since, so no cached property is out of date
+			drain_events(ps);
 			leader = wm_get_focused(ps);
 
 			if (skippy_activate(ps->mainwin, layout, leader)) {
@@ -1412,6 +1706,8 @@ mainloop(session_t *ps, bool activate_on_start) {
 		if (mw && die) {
 			printfdf(false,"(): selecting/canceling and returning to background");
 
+			finish_layout(mw, layout);
+
 			animating = false;
 
 			// Unmap the main window and all clients, to make sure focus doesn't fall out
@@ -1425,30 +1721,21 @@ mainloop(session_t *ps, bool activate_on_start) {
 
 			int selected = -1;
 			if (mw->client_to_focus && layout != LAYOUTMODE_PAGING) {
-				if (!mw->refocus) {
-					dlist *iter = dlist_find(ps->mainwin->clients,
-							clientwin_cmp_func,
-							(void *) mw->client_to_focus);
-					if (iter) {
-						childwin_focus(mw->client_to_focus);
-						selected = mw->client_to_focus->wid_client;
-					}
-				}
-				else {
-					dlist *iter = dlist_find(ps->mainwin->clients,
-							clientwin_cmp_func,
-							(void *) mw->client_to_focus_on_cancel);
-					if (iter) {
-						childwin_focus(mw->client_to_focus_on_cancel);
-						selected = mw->client_to_focus_on_cancel->wid_client;
-					}
+				// focus the window only if it is still a client
+				ClientWin *cw = mw->refocus ?
+					mw->client_to_focus_on_cancel: mw->client_to_focus;
+				if (cw && clientwin_find(mw, cw->wid_client) == cw) {
+					childwin_focus(cw);
+					selected = cw->wid_client;
 				}
 			}
 
 			if (mw->client_to_focus && layout == LAYOUTMODE_PAGING ) {
+				// read once: the WM answers wm_set_desktop_ewmh() later,
+				// so reading again would cache the desktop being left
+				long desktop = wm_get_current_desktop(ps);
 				if (!mw->refocus &&
-						mw->client_to_focus->slots
-						!= wm_get_current_desktop(ps)) {
+						mw->client_to_focus->slots != desktop) {
 					wm_set_desktop_ewmh(ps, mw->client_to_focus->slots);
 					selected = mw->client_to_focus->slots;
 				}
@@ -1460,11 +1747,10 @@ mainloop(session_t *ps, bool activate_on_start) {
 						// this trick does not work
 						// when there is only one virtual desktop
 						wm_set_desktop_ewmh(ps,
-								(wm_get_current_desktop(ps)+1)
-								% wm_get_desktops(mw->ps));
-						wm_set_desktop_ewmh(ps, wm_get_current_desktop(ps));
+								(desktop+1) % wm_get_desktops(mw->ps));
+						wm_set_desktop_ewmh(ps, desktop);
 					}
-					selected = wm_get_current_desktop(ps);
+					selected = desktop;
 				}
 			}
 
@@ -1519,7 +1805,7 @@ mainloop(session_t *ps, bool activate_on_start) {
 
 			dlist_free(mw->clientondesktop);
 			mw->clientondesktop = 0;
-			dlist_free(mw->focuslist);
+			mw->focuslist.len = 0;
 
 			// free all mini desktop representations
 			dlist_free_with_func(mw->dminis, (dlist_free_func) clientwin_destroy);
@@ -1535,9 +1821,9 @@ mainloop(session_t *ps, bool activate_on_start) {
 				clientwin_unmap(iter->data);
 			}
 
-			// Catch all errors, but remove all events
-			XSync(ps->dpy, False);
-			XSync(ps->dpy, True);
+			// Catch all errors, and remove all events only once the caches
+			// have seen them
+			drain_events(ps);
 
 			if (switchdesktop) {
 				wm_set_desktop_ewmh(ps,
@@ -1591,6 +1877,7 @@ mainloop(session_t *ps, bool activate_on_start) {
 				}
 			}
 			if (starttime < timeslice && timeslice < stabletime) {
+				finish_layout(mw, layout);
 				if (!mw->mapped)
 					mainwin_map(mw);
 
@@ -1620,9 +1907,11 @@ mainloop(session_t *ps, bool activate_on_start) {
 				&& ps->o.switchLayout == LAYOUT_COSMOS)
 					last_animated = last_rendered -= ps->o.switchWaitDuration;
 
+				leave_snapshots(mw);
 				XFlush(ps->dpy);
 			}
 			else if (timeslice >= stabletime) {
+				finish_layout(mw, layout);
 				if (!mw->mapped)
 					mainwin_map(mw);
 
@@ -1675,6 +1964,7 @@ mainloop(session_t *ps, bool activate_on_start) {
 				}
 
 				anime(ps->mainwin, ps->mainwin->clients, 1);
+				leave_snapshots(mw);
 				animating = false;
 				last_animated = last_rendered = time_in_millis();
 
@@ -1708,7 +1998,7 @@ mainloop(session_t *ps, bool activate_on_start) {
 		XEvent ev = { };
 		while ((num_events = XEventsQueued(ps->dpy, QueuedAfterReading)))
 		{
-			XNextEvent(ps->dpy, &ev);
+			next_event(ps, &ev);
 
 #ifdef DEBUG_EVENTS
 			ev_dump(ps, mw, &ev);
@@ -1719,17 +2009,9 @@ mainloop(session_t *ps, bool activate_on_start) {
 			{
 				// when mouse move within a client window, focus on it
 				if (wid) {
-					dlist *iter = mw->clientondesktop;
-					if (layout == LAYOUTMODE_PAGING)
-						iter = mw->dminis;
-					for (; iter; iter = iter->next) {
-						ClientWin *cw = (ClientWin *) iter->data;
-						if (cw->mini.window == wid) {
-							if (!(POLLIN & r_fd[1].revents)) {
-								die = clientwin_handle(cw, &ev);
-							}
-						}
-					}
+					ClientWin *cw = find_layout_mini(mw, layout, wid);
+					if (cw && !(POLLIN & r_fd[1].revents))
+						die = clientwin_handle(cw, &ev);
 				}
 
 				// Speed up responsiveness when the user is moving the mouse around
@@ -1745,7 +2027,7 @@ mainloop(session_t *ps, bool activate_on_start) {
 					if(ev_next.type != MotionNotify)
 						break;
 
-					XNextEvent(ps->dpy, &ev);
+					next_event(ps, &ev);
 					wid = ev_window(ps, &ev);
 
 					num_events--;
@@ -1753,6 +2035,7 @@ mainloop(session_t *ps, bool activate_on_start) {
 			}
 			else if (mw && ev.type == DestroyNotify) {
 				printfdf(false, "(): else if (ev.type == DestroyNotify) {");
+				finish_layout(mw, layout);
 				count_and_filter_clients(ps->mainwin);
 				if (!mw->clientondesktop) {
 					printfdf(false, "(): Last client window destroyed/unmapped, "
@@ -1761,55 +2044,20 @@ mainloop(session_t *ps, bool activate_on_start) {
 					mw->client_to_focus = NULL;
 				}
 			}
-			else if (!mw && (ev.type == ConfigureNotify || ev.type == PropertyNotify)) {
-				printfdf(false,
-						"(): else if (ev.type == ConfigureNotify || ev.type == PropertyNotify) {");
-
-				/* Coalesce contiguous ConfigureNotify/PropertyNotify events
-				 * and only perform expensive updates if actual geometry/mapstate
-				 * changed or the icon property was updated. */
-				bool saw_icon_prop = false;
-				Window last_wid = wid;
-
-				/* we already consumed one event via XNextEvent above */
-				num_events--;
-				XEvent ev_next = { };
-				while (num_events > 0) {
-					XPeekEvent(ps->dpy, &ev_next);
-					if (ev_next.type != ConfigureNotify && ev_next.type != PropertyNotify)
-						break;
-					XNextEvent(ps->dpy, &ev_next);
-					last_wid = ev_window(ps, &ev_next);
-					if (ev_next.type == PropertyNotify && ev_next.xproperty.atom == _NET_WM_ICON)
-						saw_icon_prop = true;
-					num_events--;
-				}
-
-				dlist *iter = (last_wid ? dlist_find(ps->mainwin->clients, clientwin_cmp_func, (void *) last_wid): NULL);
-				ClientWin *cw = NULL;
-				if (iter)
-					cw = (ClientWin *) iter->data;
-				if (cw) {
-					if (saw_icon_prop) {
-						cw->icon_tried = false; /* force reload on next real update */
-					}
-					if (clientwin_detect_change(cw)) {
-						clientwin_update(cw);
-						clientwin_update3(cw);
-						clientwin_update2(cw);
-					}
-					else {
-						printfdf(false, "(): no effective change detected for %#010lx, skipping updates", cw->wid_client);
-					}
-				}
+			else if (!mw && (ev.type == ConfigureNotify || ev.type == PropertyNotify
+						|| ev.type == UnmapNotify)) {
+				/* Only note what changed; the updates are done once per
+				 * client after the queue is drained. */
+				mark_dirty(ps->mainwin, &ev);
 			}
 			else if (ev.type == CreateNotify || ev.type == MapNotify) {
 				printfdf(false, "(): else if (ev.type == CreateNotify || ev.type == MapNotify) {");
+				if (mw)
+					finish_layout(mw, layout);
 				count_and_filter_clients(ps->mainwin);
-				dlist *iter = (wid ? dlist_find(ps->mainwin->clients, clientwin_cmp_func, (void *) wid): NULL);
+				ClientWin *cw = clientwin_find(ps->mainwin, wid);
 
-				if (iter) {
-					ClientWin *cw = (ClientWin *) iter->data;
+				if (cw) {
 					clientwin_update(cw);
 					clientwin_update3(cw);
 					clientwin_update2(cw);
@@ -1827,7 +2075,7 @@ mainloop(session_t *ps, bool activate_on_start) {
 						// otherwise race condition may
 						// non-deterministically lead to broken state
 						if (ev_next.type == KeymapNotify || ev_next.type == MappingNotify) {
-							XNextEvent(ps->dpy, &ev);
+							next_event(ps, &ev);
 							XRefreshKeyboardMapping(&ev.xmapping);
 							num_events--;
 							continue;
@@ -1841,7 +2089,7 @@ mainloop(session_t *ps, bool activate_on_start) {
 						 && ev_next.type != ps->xinfo.damage_ev_base + XDamageNotify)
 							break;
 
-						XNextEvent(ps->dpy, &ev);
+						next_event(ps, &ev);
 						wid = ev_window(ps, &ev);
 						num_events--;
 
@@ -1850,12 +2098,9 @@ mainloop(session_t *ps, bool activate_on_start) {
 						if (ev.type == FocusIn)
 							focus_stolen = false;
 
-						dlist *iter = (wid ? dlist_find(ps->mainwin->clients,
-								clientwin_cmp_func, (void *) wid): NULL);
-						if (iter) {
-							ClientWin *cw = (ClientWin *) iter->data;
-							cw->damaged = true;
-						}
+						ClientWin *dcw = clientwin_find(ps->mainwin, wid);
+						if (dcw)
+							dcw->damaged = true;
 					}
 				}
 
@@ -1864,11 +2109,9 @@ mainloop(session_t *ps, bool activate_on_start) {
 			else if (mw && (ps->xinfo.damage_ev_base + XDamageNotify == ev.type)) {
 				//printfdf(false, "(): else if (ev.type == XDamageNotify) {");
 				pending_damage = true;
-				dlist *iter = dlist_find(ps->mainwin->clients,
-						clientwin_cmp_func, (void *) wid);
-				if (iter) {
-					((ClientWin *)iter->data)->damaged = true;
-				}
+				ClientWin *cw = clientwin_find(ps->mainwin, wid);
+				if (cw)
+					cw->damaged = true;
 				num_events--;
 
 				{
@@ -1882,7 +2125,7 @@ mainloop(session_t *ps, bool activate_on_start) {
 						if(ev_next.type != ev_prev || wid2 != wid)
 							break;
 
-						XNextEvent(ps->dpy, &ev);
+						next_event(ps, &ev);
 						num_events--;
 					}
 				}
@@ -1900,47 +2143,40 @@ mainloop(session_t *ps, bool activate_on_start) {
 				if (ev.type == FocusIn)
 					focus_stolen = false;
 
-				bool processing = true;
-				dlist *iter = mw->clientondesktop;
-				if (layout == LAYOUTMODE_PAGING)
-					iter = mw->dminis;
-				for (; iter && processing; iter = iter->next) {
-					ClientWin *cw = (ClientWin *) iter->data;
-					if (cw->mini.window == wid) {
-						if (!(POLLIN & r_fd[1].revents)
-								&& ((layout != LAYOUTMODE_PAGING)
-								// do not process these excessive paging events
-								|| (ev.type != Expose
-								 && ev.type != GraphicsExpose
-								 && ev.type != MotionNotify
-								 && ev.type != EnterNotify
-								 && ev.type != LeaveNotify
-								 && ev.type != CreateNotify
-								 && ev.type != CirculateNotify
-								 && ev.type != ConfigureNotify
-								 && ev.type != GravityNotify
-								 && ev.type != ReparentNotify
-								))) {
-
-							die = clientwin_handle(cw, &ev);
-							if (layout == LAYOUTMODE_PAGING) {
-								cw->damaged = true;
-								pending_damage = true;
-							}
+				ClientWin *cw = find_layout_mini(mw, layout, wid);
+				if (cw) {
+					if (!(POLLIN & r_fd[1].revents)
+							&& ((layout != LAYOUTMODE_PAGING)
+							// do not process these excessive paging events
+							|| (ev.type != Expose
+							 && ev.type != GraphicsExpose
+							 && ev.type != MotionNotify
+							 && ev.type != EnterNotify
+							 && ev.type != LeaveNotify
+							 && ev.type != CreateNotify
+							 && ev.type != CirculateNotify
+							 && ev.type != ConfigureNotify
+							 && ev.type != GravityNotify
+							 && ev.type != ReparentNotify
+							))) {
+
+						die = clientwin_handle(cw, &ev);
+						if (layout == LAYOUTMODE_PAGING) {
+							cw->damaged = true;
+							pending_damage = true;
 						}
-						processing = false;
 					}
 				}
-				for (iter = mw->panels; iter && processing; iter = iter->next) {
-					ClientWin *cw = (ClientWin *) iter->data;
-					if (cw->mini.window == wid) {
-						die = mainwin_handle(mw, &ev);
-						processing = false;
-					}
+				else if ((cw = clientwin_find_mini(mw, wid))
+						&& cw->mode != CLIDISP_DESKTOP
+						&& cw->paneltype != WINTYPE_WINDOW) {
+					die = mainwin_handle(mw, &ev);
 				}
 			}
 		}
 
+		flush_dirty(ps->mainwin);
+
 		// prevent focus stealing by newly mapped window
 		// by checking for a FocusOut/FocusIn event pair
 		if (mw && ps->o.enforceFocus && focus_stolen) {
@@ -1992,6 +2228,16 @@ mainloop(session_t *ps, bool activate_on_start) {
 		//XSync(ps->dpy, True);
 		//assert(!XEventsQueued(ps->dpy, QueuedAfterReading));
 
+		// Keep the idle snapshots current, a few at a time
+		bool snapshots_due = false;
+		if (!mw && ps->o.snapshotCache) {
+			bool round = time_in_millis() - last_snapshots >= SNAPSHOT_INTERVAL;
+			snapshots_due = refresh_snapshots(ps->mainwin,
+					round ? SNAPSHOT_BATCH: 0);
+			if (round)
+				last_snapshots = time_in_millis();
+		}
+
 		last_rendered = time_in_millis();
 		XFlush(ps->dpy);
 
@@ -2004,6 +2250,8 @@ mainloop(session_t *ps, bool activate_on_start) {
 		}
 		if (animating)
 			timeout = 0;
+		else if (snapshots_due)
+			timeout = SNAPSHOT_INTERVAL;
 		poll(r_fd, (r_fd[1].fd >= 0 ? 2: 1), timeout);
 
 		// Handle daemon commands
@@ -2154,21 +2402,18 @@ mainloop(session_t *ps, bool activate_on_start) {
 					printfdf(false, "(): cycling window");
 					fflush(stdout);fflush(stderr);
 
+					// the cosmos cycling order follows the layout
+					if (layout == LAYOUTMODE_SWITCH && ps->o.switchLayout == LAYOUT_COSMOS)
+						finish_layout(mw, layout);
+
 					if ((layout == LAYOUTMODE_SWITCH && ps->o.switchCycleDesktops)
 					 || (layout == LAYOUTMODE_EXPOSE && ps->o.exposeCycleDesktops))
 					{
 						int focusindex = 0;
-						if (mw->client_to_focus) {
-							dlist *search = dlist_first(mw->focuslist);
-							ClientWin *searchdata = search->data;
-							while (searchdata != mw->client_to_focus) {
-								search = search->next;
-								searchdata = search->data;
-								focusindex++;
-							}
-						}
+						if (mw->client_to_focus)
+							focusindex = focuslist_index_of(&mw->focuslist, mw->client_to_focus);
 						if (0 > focusindex + ps->o.focus_initial
-						|| focusindex + ps->o.focus_initial >= dlist_len(mw->focuslist)) {
+						|| focusindex + ps->o.focus_initial >= mw->focuslist.len) {
 							die = true;
 							switchdesktop = true;
 						}
@@ -2176,7 +2421,7 @@ mainloop(session_t *ps, bool activate_on_start) {
 
 					int oldfocus = ps->o.focus_initial;
 					if (ps->o.focus_initial < 0)
-						ps->o.focus_initial = dlist_len(mw->focuslist) + ps->o.focus_initial;
+						ps->o.focus_initial = mw->focuslist.len + ps->o.focus_initial;
 
 					while (ps->o.focus_initial > 0 && mw->client_to_focus) {
 						focus_miniw_next(ps, mw->client_to_focus);
@@ -2773,6 +3018,7 @@ load_config_file(session_t *ps)
 			ps->o.clientList = 2;
 	}
     config_get_bool_wrap(config, "system", "pseudoTrans", &ps->o.pseudoTrans);
+    config_get_bool_wrap(config, "system", "snapshotCache", &ps->o.snapshotCache);
 
     config_get_bool_wrap(config, "multimonitor", "showOnlyCurrentMonitor", &ps->o.showOnlyCurrentMonitor);
     config_get_bool_wrap(config, "multimonitor", "showOnlyCurrentScreen", &ps->o.filterxscreen);
@@ -2825,6 +3071,8 @@ load_config_file(session_t *ps)
 	config_get_int_wrap(config, "layout", "layoutOneRowItems", &ps->o.layoutOneRowItems, 1, INT_MAX);
     config_get_int_wrap(config, "layout", "distance", &ps->o.distance, 5, INT_MAX);
     config_get_bool_wrap(config, "layout", "allowUpscale", &ps->o.allowUpscale);
+    config_get_int_wrap(config, "layout", "cosmosTimeBudget", &ps->o.cosmosTimeBudget, 0, INT_MAX);
+    config_get_double_wrap(config, "layout", "cosmosOpeningAngle", &ps->o.cosmosOpeningAngle, 0.0, 2.0);
 
     config_get_int_wrap(config, "appearance", "animationDuration", &ps->o.animationDuration, 0, 2000);
     config_get_int_wrap(config, "appearance", "animationRefresh", &ps->o.animationRefresh, 1, 200);
@@ -3027,6 +3275,8 @@ int main(int argc, char *argv[]) {
 		ps_g = ps = allocchk(malloc(sizeof(session_t)));
 		memcpy(ps, &SESSIONT_DEF, sizeof(session_t));
 		gettimeofday(&ps->time_start, NULL);
+		ps->frame_client = winmap_create();
+		ps->client_frame = winmap_create();
 	}
 
 	// First pass
@@ -3144,7 +3394,7 @@ int main(int argc, char *argv[]) {
 	}
 	ps->mainwin = mw;
 
-	XSelectInput(ps->dpy, ps->root, SubstructureNotifyMask);
+	XSelectInput(ps->dpy, ps->root, SubstructureNotifyMask | PropertyChangeMask);
 
 	// Daemon mode
 	if (ps->o.runAsDaemon) {
@@ -3229,6 +3479,7 @@ main_end:
 			free(ps->o.wm_status_str);
 		if (ps->o.desktops)
 			free(ps->o.desktops);
+		free(ps->rootprops.desktop_names);
 
 		if (ps->fd_pipe >= 0)
 			close(ps->fd_pipe);
@@ -3239,6 +3490,8 @@ main_end:
 		if (ps->dpy)
 			XCloseDisplay(dpy);
 
+		winmap_destroy(ps->frame_client);
+		winmap_destroy(ps->client_frame);
 		free(ps);
 	}
 
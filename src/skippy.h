@@ -38,6 +38,8 @@
 #include <X11/Xmd.h>
 #include <X11/Xatom.h>
 #include <X11/Xft/Xft.h>
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
 
 #include <X11/extensions/Xrender.h>
 #include <X11/extensions/Xcomposite.h>
@@ -59,6 +61,7 @@
 #include <time.h>
 #include <string.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <ctype.h>
 
 #include "dlist.h"
@@ -202,6 +205,7 @@ typedef struct {
 	char *pipePath2;
 	int clientList;
 	bool pseudoTrans;
+	bool snapshotCache;
 
 	bool showOnlyCurrentMonitor;
 	bool filterxscreen;
@@ -226,6 +230,8 @@ typedef struct {
 	bool exposeCycleDesktops;
 	int distance;
 	bool allowUpscale;
+	int cosmosTimeBudget;
+	double cosmosOpeningAngle;
 
 	int animationDuration;;
 	int animationRefresh;;
@@ -307,6 +313,7 @@ typedef struct {
 	.pipePath2 = NULL, \
 	.clientList = 0, \
 	.pseudoTrans = true, \
+	.snapshotCache = false, \
 \
 	.showOnlyCurrentMonitor = false, \
 	.filterxscreen = true, \
@@ -324,6 +331,8 @@ typedef struct {
 	.exposeCycleDesktops = false, \
 	.distance = 50, \
 	.allowUpscale = false, \
+	.cosmosTimeBudget = 0, \
+	.cosmosOpeningAngle = 0.0, \
 \
 	.animationDuration = 200, \
 	.animationRefresh = 60, \
@@ -393,8 +402,31 @@ typedef struct {
 	.xinerama_exist = false, \
 }
 
+/// @brief Cached root window properties, kept until a PropertyNotify
+/// on the root window changes them.
+typedef struct {
+	/// @brief ROOTPROP_* bits of the fields holding a value.
+	unsigned valid;
+	/// @brief Number of desktops.
+	unsigned long desktops;
+	/// @brief Current desktop.
+	long current_desktop;
+	/// @brief Raw _NET_DESKTOP_NAMES, NUL-separated.
+	char *desktop_names;
+	/// @brief Length of desktop_names in bytes.
+	unsigned long desktop_names_len;
+} rootprops_t;
+
+#define ROOTPROP_DESKTOPS        (1 << 0)
+#define ROOTPROP_CURRENT_DESKTOP (1 << 1)
+#define ROOTPROP_DESKTOP_NAMES   (1 << 2)
+
 typedef struct _clientwin_t ClientWin;
 typedef struct _mainwin_t MainWin;
+typedef struct _layout_warm_t layout_warm_t;
+typedef struct _layout_cache_t layout_cache_t;
+typedef struct _layout_job_t layout_job_t;
+typedef struct _winmap_t winmap_t;
 
 /// @brief Session global info structure.
 typedef struct {
@@ -408,6 +440,12 @@ typedef struct {
 	Window root;
 	/// @brief Information about X.
 	xinfo_t xinfo;
+	/// @brief Cached root window properties.
+	rootprops_t rootprops;
+	/// @brief Client window of each top-level frame, resolved lazily.
+	winmap_t *frame_client;
+	/// @brief Top-level frame of each client window.
+	winmap_t *client_frame;
 	/// @brief Time the program was started, in milliseconds.
 	struct timeval time_start;
 	/// @brief WM personality.
@@ -1359,6 +1397,9 @@ report_key_modifiers(XKeyEvent *evk)
 
 #include "img.h"
 #include "wm.h"
+#include "winmap.h"
+#include "cwvec.h"
+#include "maskcache.h"
 #include "mainwin.h"
 #include "clientwin.h"
 #include "layout.h"
@@ -1379,10 +1420,8 @@ report_key_modifiers(XKeyEvent *evk)
 #endif
 
 static inline int
-sort_cw_by_row(dlist* dlist1, dlist* dlist2, void* data)
+cw_cmp_by_row(const ClientWin *cw1, const ClientWin *cw2)
 {
-	ClientWin *cw1 = (ClientWin *) dlist1->data;
-	ClientWin *cw2 = (ClientWin *) dlist2->data;
 	if (cw1->y < cw2->y)
 		return -1;
 	else if (cw1->y > cw2->y)
@@ -1395,14 +1434,14 @@ sort_cw_by_row(dlist* dlist1, dlist* dlist2, void* data)
 		return 0;
 }
 
+// by the cell of a grid the windows fall in, row first, the cell size
+// being the same for all pairs so that the order is a total one
 static inline int
-sort_cw_by_column(dlist* dlist1, dlist* dlist2, void* data)
+cw_cmp_by_column(const ClientWin *cw1, const ClientWin *cw2, void *data)
 {
-	ClientWin *cw1 = (ClientWin *) dlist1->data;
-	ClientWin *cw2 = (ClientWin *) dlist2->data;
-
-	int tilewidth = MIN(cw1->src.width, cw2->src.width);
-	int tileheight = MIN(cw1->src.height, cw2->src.height);
+	const int *tile = data;
+	int tilewidth = tile[0];
+	int tileheight = tile[1];
 
 	int cw1x = cw1->x / tilewidth,
 		cw1y = cw1->y / tileheight,
@@ -1421,11 +1460,8 @@ sort_cw_by_column(dlist* dlist1, dlist* dlist2, void* data)
 }
 
 static inline int
-sort_cw_by_id(dlist* dlist1, dlist* dlist2, void* data)
+cw_cmp_by_id(const ClientWin *cw1, const ClientWin *cw2)
 {
-	ClientWin *cw1 = (ClientWin *) dlist1->data;
-	ClientWin *cw2 = (ClientWin *) dlist2->data;
-
 	if (cw1->src.window < cw2->src.window)
 		return -1;
 	else if (cw1->src.window > cw2->src.window)
@@ -1434,11 +1470,33 @@ sort_cw_by_id(dlist* dlist1, dlist* dlist2, void* data)
 		return 0;
 }
 
+static inline int
+sort_cw_by_row(dlist* dlist1, dlist* dlist2, void* data)
+{
+	return cw_cmp_by_row(dlist1->data, dlist2->data);
+}
+
+static inline int
+sort_cw_by_column(dlist* dlist1, dlist* dlist2, void* data)
+{
+	return cw_cmp_by_column(dlist1->data, dlist2->data, data);
+}
+
+static inline int
+sort_cw_by_id(dlist* dlist1, dlist* dlist2, void* data)
+{
+	return cw_cmp_by_id(dlist1->data, dlist2->data);
+}
+
 Picture XRoundedRectMask(session_t *ps,
 		int w, int h,
 		int radius,
 		Pixmap *out_pix);
 
+Picture XRoundedRectMaskCached(session_t *ps,
+		int w, int h,
+		int radius);
+
 void XRoundedRectComposite(session_t *ps,
 		Picture src,
 		Picture dst,
@@ -0,0 +1,132 @@
+/* Skippy-xd
+ *
+ * Copyright (C) 2004 Hyriand <hyriand@thegraveyard.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "skippy.h"
+
+#define WINMAP_INITIAL_CAPACITY 64
+
+static inline size_t
+winmap_slot(const winmap_t *map, Window wid) {
+	// window ids of a client share their high bits and count up,
+	// so spread them with a Fibonacci hash
+	uint64_t h = (uint64_t) wid * UINT64_C(0x9E3779B97F4A7C15);
+	return (size_t) (h ^ (h >> 32)) & (map->capacity - 1);
+}
+
+static void
+winmap_resize(winmap_t *map, size_t capacity) {
+	winmap_entry_t *old = map->entries;
+	size_t old_capacity = map->capacity;
+
+	map->entries = scalloc(capacity, winmap_entry_t);
+	map->capacity = capacity;
+
+	for (size_t i = 0; i < old_capacity; i++) {
+		if (!old[i].wid)
+			continue;
+		size_t k = winmap_slot(map, old[i].wid);
+		while (map->entries[k].wid)
+			k = (k + 1) & (capacity - 1);
+		map->entries[k] = old[i];
+	}
+
+	free(old);
+}
+
+winmap_t *
+winmap_create(void) {
+	return scalloc(1, winmap_t);
+}
+
+void
+winmap_destroy(winmap_t *map) {
+	if (!map)
+		return;
+	free(map->entries);
+	free(map);
+}
+
+void *
+winmap_get(const winmap_t *map, Window wid) {
+	if (!wid || !map->size)
+		return NULL;
+
+	for (size_t k = winmap_slot(map, wid); map->entries[k].wid;
+			k = (k + 1) & (map->capacity - 1)) {
+		if (map->entries[k].wid == wid)
+			return map->entries[k].data;
+	}
+
+	return NULL;
+}
+
+void
+winmap_set(winmap_t *map, Window wid, void *data) {
+	if (!wid)
+		return;
+
+	// keep the load under one half, for short probe sequences
+	if (2 * (map->size + 1) > map->capacity)
+		winmap_resize(map, map->capacity ? 2 * map->capacity: WINMAP_INITIAL_CAPACITY);
+
+	size_t k = winmap_slot(map, wid);
+	while (map->entries[k].wid && map->entries[k].wid != wid)
+		k = (k + 1) & (map->capacity - 1);
+
+	if (!map->entries[k].wid)
+		map->size++;
+	map->entries[k].wid = wid;
+	map->entries[k].data = data;
+}
+
+void
+winmap_remove(winmap_t *map, Window wid, const void *data) {
+	if (!wid || !map->size)
+		return;
+
+	size_t mask = map->capacity - 1;
+	size_t k = winmap_slot(map, wid);
+	while (map->entries[k].wid && map->entries[k].wid != wid)
+		k = (k + 1) & mask;
+	if (!map->entries[k].wid || map->entries[k].data != data)
+		return;
+
+	// shift the rest of the probe sequence back instead of leaving a
+	// tombstone, so lookups never walk over deleted entries
+	size_t hole = k;
+	for (size_t j = (k + 1) & mask; map->entries[j].wid; j = (j + 1) & mask) {
+		size_t home = winmap_slot(map, map->entries[j].wid);
+		// the entry may move into the hole unless its home lies
+		// cyclically within (hole, j]
+		if (((j - home) & mask) >= ((j - hole) & mask)) {
+			map->entries[hole] = map->entries[j];
+			hole = j;
+		}
+	}
+	map->entries[hole].wid = None;
+	map->entries[hole].data = NULL;
+	map->size--;
+}
+
+void
+winmap_clear(winmap_t *map) {
+	if (map->size)
+		memset(map->entries, 0, map->capacity * sizeof(winmap_entry_t));
+	map->size = 0;
+}
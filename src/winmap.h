@@ -0,0 +1,49 @@
+/* Skippy-xd
+ *
+ * Copyright (C) 2004 Hyriand <hyriand@thegraveyard.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SKIPPY_WINMAP_H
+#define SKIPPY_WINMAP_H
+
+// hash map from X window ids to pointers, open addressing with linear
+// probing, None is never a key
+
+typedef struct {
+	Window wid;
+	void *data;
+} winmap_entry_t;
+
+struct _winmap_t {
+	// power of two, or 0 before the first insertion
+	size_t capacity;
+	size_t size;
+	winmap_entry_t *entries;
+};
+
+winmap_t *winmap_create(void);
+void winmap_destroy(winmap_t *map);
+// data stored for wid, NULL if there is none
+void *winmap_get(const winmap_t *map, Window wid);
+// store data for wid, replacing what was there
+void winmap_set(winmap_t *map, Window wid, void *data);
+// forget wid, only if it still maps to data
+void winmap_remove(winmap_t *map, Window wid, const void *data);
+// forget everything, keeping the storage
+void winmap_clear(winmap_t *map);
+
+#endif /* SKIPPY_WINMAP_H */
@@ -375,9 +375,119 @@ wm_find_client(session_t *ps, Window wid) {
 	return result;
 }
 
-static inline dlist *
-wm_get_stack_fromprop(session_t *ps, Window root, Atom a) {
-	dlist *l = NULL;
+// frame_client value of a top-level window holding no client
+static char wm_no_client;
+
+// forget what the frame maps know about wid, as a frame or as a client
+static void
+wm_frames_forget(session_t *ps, Window wid) {
+	void *client = winmap_get(ps->frame_client, wid);
+	if (client) {
+		winmap_remove(ps->frame_client, wid, client);
+		if (&wm_no_client != client)
+			winmap_remove(ps->client_frame, (Window) client, (void *) wid);
+	}
+
+	void *frame = winmap_get(ps->client_frame, wid);
+	if (frame) {
+		winmap_remove(ps->client_frame, wid, frame);
+		winmap_remove(ps->frame_client, (Window) frame, (void *) wid);
+	}
+}
+
+// record that frame holds client, or no client if client is None
+static void
+wm_frames_link(session_t *ps, Window frame, Window client) {
+	wm_frames_forget(ps, frame);
+	if (!client) {
+		winmap_set(ps->frame_client, frame, &wm_no_client);
+		return;
+	}
+	wm_frames_forget(ps, client);
+	winmap_set(ps->frame_client, frame, (void *) client);
+	winmap_set(ps->client_frame, client, (void *) frame);
+}
+
+/**
+ * @brief Find the client window under a top-level window, remembering
+ * the answer until the frame maps see the window change.
+ */
+static Window
+wm_frame_client(session_t *ps, Window wid) {
+	void *client = winmap_get(ps->frame_client, wid);
+	if (client)
+		return &wm_no_client == client ? None: (Window) client;
+
+	Window found = wm_find_client(ps, wid);
+	wm_frames_link(ps, wid, found);
+	return found;
+}
+
+// the child of the root window holding wid, or None
+static Window
+wm_find_toplevel(session_t *ps, Window wid) {
+	while (wid) {
+		Window rroot = None, parent = None;
+		Window *children = NULL;
+		unsigned nchildren = 0;
+		if (!XQueryTree(ps->dpy, wid, &rroot, &parent, &children, &nchildren))
+			return None;
+		sxfree(children);
+		if (parent == ps->root)
+			return wid;
+		wid = parent;
+	}
+
+	return None;
+}
+
+/**
+ * @brief Keep the frame maps current from the root window's
+ * SubstructureNotify events.
+ *
+ * Entries are only dropped here; they are filled in again on the next
+ * lookup.
+ */
+void
+wm_frames_track(session_t *ps, const XEvent *ev) {
+	switch (ev->type) {
+		case CreateNotify:
+			wm_frames_forget(ps, ev->xcreatewindow.window);
+			break;
+		case DestroyNotify:
+			wm_frames_forget(ps, ev->xdestroywindow.window);
+			break;
+		case MapNotify:
+			// a window the WM just managed may have gained WM_STATE
+			if (&wm_no_client == winmap_get(ps->frame_client, ev->xmap.window))
+				wm_frames_forget(ps, ev->xmap.window);
+			break;
+		case UnmapNotify:
+			// a top-level client may be withdrawn without reparenting
+			if ((void *) ev->xunmap.window
+					== winmap_get(ps->frame_client, ev->xunmap.window))
+				wm_frames_forget(ps, ev->xunmap.window);
+			break;
+		case ReparentNotify:
+			wm_frames_forget(ps, ev->xreparent.window);
+			if (ev->xreparent.parent != ps->root)
+				wm_frames_forget(ps, wm_find_toplevel(ps, ev->xreparent.parent));
+			break;
+	}
+}
+
+static inline void
+wm_stack_push(Window **stack, int *n, int *cap, Window wid) {
+	if (*n == *cap) {
+		*cap = MAX(*cap * 2, 64);
+		*stack = srealloc(*stack, *cap, Window);
+	}
+	(*stack)[(*n)++] = wid;
+}
+
+static inline void
+wm_get_stack_fromprop(session_t *ps, Window root, Atom a,
+		Window **stack, int *n, int *cap) {
 	unsigned char *data = NULL;
 	int real_format = 0;
 	Atom real_type = None;
@@ -387,28 +497,27 @@ wm_get_stack_fromprop(session_t *ps, Window root, Atom a) {
 			&items_read, &items_left, &data);
 	if (Success == status && 32 == real_format && data)
 		for (int i = 0; i < items_read; i++) {
-			l = dlist_add(l, (void *) ((long *) data)[i]);
+			wm_stack_push(stack, n, cap, (Window) ((long *) data)[i]);
 		}
 
 	sxfree(data);
-	return l;
 }
 
-static inline dlist *
-wm_get_stack_sub(session_t *ps, Window root) {
-	dlist *l = NULL;
-
+static inline void
+wm_get_stack_sub(session_t *ps, Window root, Window **stack, int *n, int *cap) {
 	// does not give info on windows z-order
 	switch (ps->o.clientList) {
 		// EWMH
 		case 1:
 			printfdf(false, "(): Retrieved window stack from _NET_CLIENT_LIST.");
-			return wm_get_stack_fromprop(ps, root, _NET_CLIENT_LIST);
+			wm_get_stack_fromprop(ps, root, _NET_CLIENT_LIST, stack, n, cap);
+			break;
 
 		// GNOME WM
 		case 2:
 			printfdf(false, "(): Retrieved window stack from _WIN_CLIENT_LIST.");
-			return wm_get_stack_fromprop(ps, root, _WIN_CLIENT_LIST);
+			wm_get_stack_fromprop(ps, root, _WIN_CLIENT_LIST, stack, n, cap);
+			break;
 
 		// Stupid method, but this gives windows ordered by z-order
 		default:
@@ -422,7 +531,9 @@ wm_get_stack_sub(session_t *ps, Window root) {
 				// so we can't skip override-redirect windows.
 				for (int i = 0; i < nchildren; ++i) {
 					Window wid = children[i];
-					Window client = wm_find_client(ps, wid);
+					// only the root window we watch keeps the frame maps current
+					Window client = ps->root == root ? wm_frame_client(ps, wid):
+						wm_find_client(ps, wid);
 					// both obsolete config options
 					// ps->o.acceptOvRedir and ps->o.acceptWMWin were always false
 					// hence this loop never runs
@@ -435,26 +546,27 @@ wm_get_stack_sub(session_t *ps, Window root) {
 						}
 					}*/
 					if (client)
-						l = dlist_add(l, (void *) client);
+						wm_stack_push(stack, n, cap, client);
 				}
 			}
 			sxfree(children);
 			printfdf(false, "(): Retrieved window stack by querying all children.");
 		}
 	}
-
-	return l;
 }
 
-dlist *
-wm_get_stack(session_t *ps) {
+// the caller frees the returned array of *n windows
+Window *
+wm_get_stack(session_t *ps, int *n) {
+	Window *stack = NULL;
+	int cap = 0;
+	*n = 0;
 	if (!ps->o.filterxscreen) {
-		dlist *l = NULL;
 		for (int i = 0; i < ScreenCount(ps->dpy); ++i)
-			l = dlist_join(l, wm_get_stack_sub(ps, RootWindow(ps->dpy, i)));
-		return l;
+			wm_get_stack_sub(ps, RootWindow(ps->dpy, i), &stack, n, &cap);
 	}
-	else return wm_get_stack_sub(ps, ps->root);
+	else wm_get_stack_sub(ps, ps->root, &stack, n, &cap);
+	return stack;
 }
 
 Pixmap
@@ -485,8 +597,8 @@ wm_get_root_pmap(Display *dpy)
 	return rootpmap;
 }
 
-unsigned long
-wm_get_desktops(session_t *ps) {
+static unsigned long
+wm_fetch_desktops(session_t *ps) {
 	Atom real_type;
 	int real_format;
 	unsigned long items_read, items_left;
@@ -516,8 +628,18 @@ return_status:
 	return num_desktops;
 }
 
-long
-wm_get_current_desktop(session_t *ps) {
+unsigned long
+wm_get_desktops(session_t *ps) {
+	rootprops_t *rp = &ps->rootprops;
+	if (!(rp->valid & ROOTPROP_DESKTOPS)) {
+		rp->desktops = wm_fetch_desktops(ps);
+		rp->valid |= ROOTPROP_DESKTOPS;
+	}
+	return rp->desktops;
+}
+
+static long
+wm_fetch_current_desktop(session_t *ps) {
 	winprop_t prop = { };
 	long desktop = 0;
 
@@ -534,13 +656,23 @@ wm_get_current_desktop(session_t *ps) {
 	return desktop;
 }
 
+long
+wm_get_current_desktop(session_t *ps) {
+	rootprops_t *rp = &ps->rootprops;
+	if (!(rp->valid & ROOTPROP_CURRENT_DESKTOP)) {
+		rp->current_desktop = wm_fetch_current_desktop(ps);
+		rp->valid |= ROOTPROP_CURRENT_DESKTOP;
+	}
+	return rp->current_desktop;
+}
+
 /**
  * @brief Retrieve the title of a window.
  *
  * Must be a UTF-8 string.
  */
-FcChar8 *
-wm_get_window_title(session_t *ps, Window wid, int *length_return) {
+static char *
+wm_fetch_window_title(session_t *ps, Window wid) {
 	char *ret = NULL;
 
 	// wm_wid_get_prop_utf8() is certainly more appropriate, yet
@@ -551,36 +683,407 @@ wm_get_window_title(session_t *ps, Window wid, int *length_return) {
 		ret = wm_wid_get_prop_rstr(ps, wid, _NET_WM_NAME);
 	if (!ret)
 		ret = wm_wid_get_prop_rstr(ps, wid, XA_WM_NAME);
+
+	return ret;
+}
+
+static long
+wm_fetch_window_desktop(session_t *ps, Window wid) {
+	long desktop = LONG_MIN;
+	winprop_t prop = { };
+
+	// Check for sticky window
+	if (WMPSN_GNOME == ps->wmpsn) {
+		prop = wid_get_prop(ps, wid, _WIN_STATE, 1, XA_CARDINAL, 0);
+		if (WIN_STATE_STICKY & winprop_get_int(&prop))
+			desktop = -1;
+		free_winprop(&prop);
+		if (LONG_MIN != desktop)
+			return desktop;
+	}
+
+	prop = wid_get_prop(ps, wid, _NET_WM_DESKTOP, 1, XA_CARDINAL, 0);
+	if (prop.nitems)
+		desktop = winprop_get_int(&prop);
+	if ((long) 0xFFFFFFFFL == desktop)
+		desktop = -1;
+	free_winprop(&prop);
+	if (LONG_MIN != desktop) return desktop;
+
+	prop = wid_get_prop(ps, wid, _WIN_WORKSPACE, 1, XA_CARDINAL, 0);
+	if (prop.nitems)
+		desktop = winprop_get_int(&prop);
+	free_winprop(&prop);
+
+	return desktop;
+}
+
+/**
+ * Get the cached properties of a client window, fetching the ones in
+ * which that are not cached yet. Other windows get their properties
+ * fetched into scratch, to be released with wm_props_done().
+ */
+static wm_props_t *
+wm_props_get(session_t *ps, Window wid, unsigned which, wm_props_t *scratch) {
+	wm_props_t *props = NULL;
+	if (ps->mainwin) {
+		ClientWin *cw = winmap_get(ps->mainwin->clients_by_wid, wid);
+		if (cw)
+			props = &cw->props;
+	}
+	if (!props) {
+		memset(scratch, 0, sizeof(wm_props_t));
+		props = scratch;
+	}
+
+	unsigned missing = which & ~props->valid;
+
+	if (missing & WM_PROP_DESKTOP)
+		props->desktop = wm_fetch_window_desktop(ps, wid);
+
+	if (missing & WM_PROP_TYPE) {
+		winprop_t prop = wid_get_prop(ps, wid, _NET_WM_WINDOW_TYPE, 1, XA_ATOM, 32);
+		props->wintype = winprop_get_int(&prop);
+		free_winprop(&prop);
+	}
+
+	if (missing & WM_PROP_STATE) {
+		winprop_t prop = wid_get_prop(ps, wid, _NET_WM_STATE, 8192, XA_ATOM, 32);
+		free(props->state);
+		props->state = NULL;
+		props->nstate = prop.nitems;
+		if (prop.nitems) {
+			props->state = smalloc(prop.nitems, long);
+			for (int i = 0; i < prop.nitems; i++)
+				props->state[i] = prop.data32[i];
+		}
+		free_winprop(&prop);
+	}
+
+	if (missing & WM_PROP_CLASS) {
+		free(props->res_class);
+		free(props->res_name);
+		props->res_class = props->res_name = NULL;
+		XClassHint *hints = allocchk(XAllocClassHint());
+		if (XGetClassHint(ps->dpy, wid, hints)) {
+			if (hints->res_class)
+				props->res_class = mstrdup(hints->res_class);
+			if (hints->res_name)
+				props->res_name = mstrdup(hints->res_name);
+			XFree(hints->res_class);
+			XFree(hints->res_name);
+		}
+		XFree(hints);
+	}
+
+	if (missing & WM_PROP_TITLE) {
+		free(props->title);
+		props->title = wm_fetch_window_title(ps, wid);
+	}
+
+	props->valid |= missing;
+	return props;
+}
+
+// the properties wm_props_prefetch() asks for, title ones in order of preference
+enum {
+	PREFETCH_TYPE,
+	PREFETCH_STATE,
+	PREFETCH_DESKTOP,
+	PREFETCH_CLASS,
+	PREFETCH_VISIBLE_NAME,
+	PREFETCH_NAME,
+	PREFETCH_WM_NAME,
+	PREFETCH_COUNT,
+};
+
+/**
+ * Check a GetProperty reply the way wid_get_prop_adv() checks its
+ * result, returning the number of items, 0 for a blank one.
+ */
+static int
+wm_prefetch_items(const xcb_get_property_reply_t *r, Atom rtype, int rformat) {
+	if (!r || !r->value_len
+			|| (rtype != AnyPropertyType && r->type != rtype)
+			|| (rformat && r->format != rformat)
+			|| (8 != r->format && 16 != r->format && 32 != r->format))
+		return 0;
+	return r->value_len;
+}
+
+static long
+wm_prefetch_item(const xcb_get_property_reply_t *r, int i) {
+	const void *data = xcb_get_property_value(r);
+	switch (r->format) {
+		case 8:  return ((const uint8_t *) data)[i];
+		case 16: return ((const uint16_t *) data)[i];
+		default: return ((const uint32_t *) data)[i];
+	}
+}
+
+// a copy of the 8-bit data, NUL-terminated as Xlib returns it
+static char *
+wm_prefetch_string(const xcb_get_property_reply_t *r) {
+	int len = r->value_len;
+	char *str = smalloc(len + 1, char);
+	memcpy(str, xcb_get_property_value(r), len);
+	str[len] = '\0';
+	return str;
+}
+
+/**
+ * Fill the property cache of many clients at once.
+ *
+ * The GetProperty requests of every client go out over the XCB
+ * connection beneath the Display before the first reply is awaited, so
+ * a cold activation costs about one round trip instead of one per
+ * property and window. Properties already cached are skipped, and
+ * whatever cannot be told from the replies is left for the Xlib path.
+ */
+void
+wm_props_prefetch(session_t *ps, dlist *clients, unsigned which) {
+	int n = dlist_len(clients);
+	if (!n)
+		return;
+
+	static const struct {
+		unsigned bit;
+		long length;
+	} requests[PREFETCH_COUNT] = {
+		[PREFETCH_TYPE] = { WM_PROP_TYPE, 1 },
+		[PREFETCH_STATE] = { WM_PROP_STATE, 8192 },
+		[PREFETCH_DESKTOP] = { WM_PROP_DESKTOP, 1 },
+		[PREFETCH_CLASS] = { WM_PROP_CLASS, BUFSIZ },
+		[PREFETCH_VISIBLE_NAME] = { WM_PROP_TITLE, 128 },
+		[PREFETCH_NAME] = { WM_PROP_TITLE, 128 },
+		[PREFETCH_WM_NAME] = { WM_PROP_TITLE, 128 },
+	};
+	const Atom atoms[PREFETCH_COUNT] = {
+		[PREFETCH_TYPE] = _NET_WM_WINDOW_TYPE,
+		[PREFETCH_STATE] = _NET_WM_STATE,
+		[PREFETCH_DESKTOP] = _NET_WM_DESKTOP,
+		[PREFETCH_CLASS] = XA_WM_CLASS,
+		[PREFETCH_VISIBLE_NAME] = _NET_WM_VISIBLE_NAME,
+		[PREFETCH_NAME] = _NET_WM_NAME,
+		[PREFETCH_WM_NAME] = XA_WM_NAME,
+	};
+	const Atom types[PREFETCH_COUNT] = {
+		[PREFETCH_TYPE] = XA_ATOM,
+		[PREFETCH_STATE] = XA_ATOM,
+		[PREFETCH_DESKTOP] = XA_CARDINAL,
+		[PREFETCH_CLASS] = XA_STRING,
+		[PREFETCH_VISIBLE_NAME] = AnyPropertyType,
+		[PREFETCH_NAME] = AnyPropertyType,
+		[PREFETCH_WM_NAME] = AnyPropertyType,
+	};
+
+	// the desktop of GNOME WMs depends on more than _NET_WM_DESKTOP
+	if (WMPSN_GNOME == ps->wmpsn)
+		which &= ~WM_PROP_DESKTOP;
+
+	ClientWin **cws = smalloc(n, ClientWin *);
+	unsigned *asked = scalloc(n, unsigned);
+	xcb_get_property_cookie_t *cookies = smalloc(n * PREFETCH_COUNT,
+			xcb_get_property_cookie_t);
+
+	// Xlib requests still buffered must not be overtaken
+	XFlush(ps->dpy);
+	xcb_connection_t *c = XGetXCBConnection(ps->dpy);
+
+	int i = 0;
+	foreach_dlist (clients) {
+		ClientWin *cw = iter->data;
+		cws[i] = cw;
+		asked[i] = which & ~cw->props.valid;
+		for (int k = 0; k < PREFETCH_COUNT; k++)
+			if (asked[i] & requests[k].bit)
+				cookies[i * PREFETCH_COUNT + k] = xcb_get_property(c, 0,
+						cw->wid_client, atoms[k], types[k], 0, requests[k].length);
+		i++;
+	}
+
+	for (i = 0; i < n; i++) {
+		wm_props_t *props = &cws[i]->props;
+		xcb_get_property_reply_t *r[PREFETCH_COUNT] = { NULL };
+		for (int k = 0; k < PREFETCH_COUNT; k++) {
+			if (!(asked[i] & requests[k].bit))
+				continue;
+			xcb_generic_error_t *err = NULL;
+			r[k] = xcb_get_property_reply(c, cookies[i * PREFETCH_COUNT + k], &err);
+			free(err);
+		}
+
+		if (asked[i] & WM_PROP_TYPE) {
+			props->wintype = wm_prefetch_items(r[PREFETCH_TYPE], XA_ATOM, 32) ?
+				wm_prefetch_item(r[PREFETCH_TYPE], 0): 0;
+			props->valid |= WM_PROP_TYPE;
+		}
+
+		if (asked[i] & WM_PROP_STATE) {
+			int nitems = wm_prefetch_items(r[PREFETCH_STATE], XA_ATOM, 32);
+			free(props->state);
+			props->state = nitems ? smalloc(nitems, long): NULL;
+			props->nstate = nitems;
+			for (int k = 0; k < nitems; k++)
+				props->state[k] = wm_prefetch_item(r[PREFETCH_STATE], k);
+			props->valid |= WM_PROP_STATE;
+		}
+
+		// without _NET_WM_DESKTOP, _WIN_WORKSPACE is tried later
+		if ((asked[i] & WM_PROP_DESKTOP)
+				&& wm_prefetch_items(r[PREFETCH_DESKTOP], XA_CARDINAL, 0)) {
+			long desktop = wm_prefetch_item(r[PREFETCH_DESKTOP], 0);
+			props->desktop = (long) 0xFFFFFFFFL == desktop ? -1: desktop;
+			props->valid |= WM_PROP_DESKTOP;
+		}
+
+		if (asked[i] & WM_PROP_CLASS) {
+			free(props->res_class);
+			free(props->res_name);
+			props->res_class = props->res_name = NULL;
+			int nitems = wm_prefetch_items(r[PREFETCH_CLASS], XA_STRING, 8);
+			if (nitems) {
+				// res_name and res_class, split like XGetClassHint() does
+				char *data = wm_prefetch_string(r[PREFETCH_CLASS]);
+				int len_name = strlen(data);
+				props->res_name = mstrdup(data);
+				if (len_name == nitems)
+					len_name--;
+				props->res_class = mstrdup(data + len_name + 1);
+				free(data);
+			}
+			props->valid |= WM_PROP_CLASS;
+		}
+
+		if (asked[i] & WM_PROP_TITLE) {
+			free(props->title);
+			props->title = NULL;
+			for (int k = PREFETCH_VISIBLE_NAME; k <= PREFETCH_WM_NAME && !props->title; k++)
+				if (wm_prefetch_items(r[k], AnyPropertyType, 8))
+					props->title = wm_prefetch_string(r[k]);
+			props->valid |= WM_PROP_TITLE;
+		}
+
+		for (int k = 0; k < PREFETCH_COUNT; k++)
+			free(r[k]);
+	}
+
+	free(cookies);
+	free(asked);
+	free(cws);
+}
+
+static inline void
+wm_props_done(wm_props_t *props, wm_props_t *scratch) {
+	if (props == scratch)
+		wm_props_free(scratch);
+}
+
+void
+wm_props_free(wm_props_t *props) {
+	free(props->state);
+	free(props->res_class);
+	free(props->res_name);
+	free(props->title);
+	memset(props, 0, sizeof(wm_props_t));
+}
+
+/**
+ * Forget the cached value of a property of a client window.
+ */
+void
+wm_props_invalidate(session_t *ps, Window wid, Atom atom) {
+	if (wid == ps->root) {
+		if (atom == _NET_NUMBER_OF_DESKTOPS || atom == _WIN_WORKSPACE_COUNT)
+			ps->rootprops.valid &= ~ROOTPROP_DESKTOPS;
+		else if (atom == _NET_CURRENT_DESKTOP || atom == _WIN_WORKSPACE)
+			ps->rootprops.valid &= ~ROOTPROP_CURRENT_DESKTOP;
+		else if (atom == _NET_DESKTOP_NAMES)
+			ps->rootprops.valid &= ~ROOTPROP_DESKTOP_NAMES;
+		return;
+	}
+	if (!ps->mainwin)
+		return;
+	ClientWin *cw = winmap_get(ps->mainwin->clients_by_wid, wid);
+	if (!cw)
+		return;
+
+	if (atom == _NET_WM_DESKTOP || atom == _WIN_WORKSPACE || atom == _WIN_STATE)
+		cw->props.valid &= ~WM_PROP_DESKTOP;
+	else if (atom == _NET_WM_WINDOW_TYPE)
+		cw->props.valid &= ~WM_PROP_TYPE;
+	else if (atom == _NET_WM_STATE)
+		cw->props.valid &= ~WM_PROP_STATE;
+	else if (atom == XA_WM_CLASS)
+		cw->props.valid &= ~WM_PROP_CLASS;
+	else if (atom == _NET_WM_VISIBLE_NAME || atom == _NET_WM_NAME
+			|| atom == XA_WM_NAME)
+		cw->props.valid &= ~WM_PROP_TITLE;
+}
+
+FcChar8 *
+wm_get_window_title(session_t *ps, Window wid, int *length_return) {
+	wm_props_t scratch;
+	wm_props_t *props = wm_props_get(ps, wid, WM_PROP_TITLE, &scratch);
+	char *ret = props->title ? mstrdup(props->title): NULL;
+	wm_props_done(props, &scratch);
+
 	if (ret && length_return)
 		*length_return = strlen(ret);
 
 	return (FcChar8 *) ret;
 }
 
+/**
+ * Get copies of the WM_CLASS parts of a window, NULL when missing.
+ */
+void
+wm_get_window_class(session_t *ps, Window wid, char **res_class, char **res_name) {
+	wm_props_t scratch;
+	wm_props_t *props = wm_props_get(ps, wid, WM_PROP_CLASS, &scratch);
+	*res_class = props->res_class ? mstrdup(props->res_class): NULL;
+	*res_name = props->res_name ? mstrdup(props->res_name): NULL;
+	wm_props_done(props, &scratch);
+}
+
 FcChar8 *
 wm_get_desktop_name(session_t *ps, int desktop) {
-	unsigned char *dup, *buffer = NULL, *data = NULL;
-	int real_format = 0;
-	Atom real_type = None;
-	unsigned long items_read = 0, items_left = 0;
-	int status = XGetWindowProperty(ps->dpy, DefaultRootWindow(ps->dpy),
-			_NET_DESKTOP_NAMES, 0L, 8192L, False, AnyPropertyType, &real_type, &real_format,
-			&items_read, &items_left, &buffer);
-
-	data = buffer;
-	if (Success == status && buffer != NULL) {
-		for (int i=0; i<desktop; i++) {
-			data = (unsigned char *) strchr((char *)data, '\0');
-			data++;
+	rootprops_t *rp = &ps->rootprops;
+	if (!(rp->valid & ROOTPROP_DESKTOP_NAMES)) {
+		unsigned char *buffer = NULL;
+		int real_format = 0;
+		Atom real_type = None;
+		unsigned long items_read = 0, items_left = 0;
+		int status = XGetWindowProperty(ps->dpy, ps->root,
+				_NET_DESKTOP_NAMES, 0L, 8192L, False, AnyPropertyType, &real_type, &real_format,
+				&items_read, &items_left, &buffer);
+
+		free(rp->desktop_names);
+		rp->desktop_names = NULL;
+		rp->desktop_names_len = 0;
+		if (Success == status && buffer != NULL) {
+			// keep the terminating NUL Xlib appends to the data
+			rp->desktop_names = allocchk(malloc(items_read + 1));
+			memcpy(rp->desktop_names, buffer, items_read + 1);
+			rp->desktop_names_len = items_read;
 		}
-		dup = malloc(strlen((char *) data) + 1);
-		strcpy((char *) dup, (char *) data);
-	} else {
-		dup = malloc(snprintf(NULL, 0, "%i", desktop) + 1);
-		sprintf((char *)dup, "%i", desktop);
+		XFree(buffer);
+		rp->valid |= ROOTPROP_DESKTOP_NAMES;
+	}
+
+	const char *data = rp->desktop_names;
+	const char *end = data + rp->desktop_names_len;
+	for (int i=0; data && i<desktop; i++) {
+		data = strchr(data, '\0') + 1;
+		if (data >= end)
+			data = NULL;
 	}
 
-	XFree(buffer);
+	if (data)
+		return (FcChar8 *) mstrdup(data);
+
+	FcChar8 *dup = malloc(snprintf(NULL, 0, "%i", desktop) + 1);
+	sprintf((char *)dup, "%i", desktop);
 	return dup;
 }
 
@@ -670,46 +1173,35 @@ wintype_t
 wm_identify_panel(session_t *ps, Window wid) {
 	wintype_t result = WINTYPE_WINDOW;
 	// Check _NET_WM_WINDOW_TYPE
-	winprop_t prop = wid_get_prop(ps, wid, _NET_WM_WINDOW_TYPE, 1, XA_ATOM, 32);
+	wm_props_t scratch;
+	wm_props_t *props = wm_props_get(ps, wid, WM_PROP_TYPE, &scratch);
 	{
-		long v = winprop_get_int(&prop);
+		long v = props->wintype;
 		if (_NET_WM_WINDOW_TYPE_DOCK == v)
 			result = WINTYPE_PANEL;
 		if (_NET_WM_WINDOW_TYPE_DESKTOP == v)
 			result = WINTYPE_DESKTOP;
 	}
-	free_winprop(&prop);
+	wm_props_done(props, &scratch);
 
 	return result;
 }
 
-bool
-wm_validate_window(session_t *ps, Window wid) {
+static bool
+wm_validate_window_props(session_t *ps, Window wid, const wm_props_t *props) {
 	{
-		bool shortcircuit = false;
-		winprop_t prop = wid_get_prop(ps, wid, _NET_WM_WINDOW_TYPE, 1, XA_ATOM, 32);
-		long v = winprop_get_int(&prop);
+		long v = props->wintype;
 		if ((_NET_WM_WINDOW_TYPE_DESKTOP == v
 				|| _NET_WM_WINDOW_TYPE_DOCK == v
 				|| _NET_WM_WINDOW_TYPE_POPUP_MENU == v))
-			shortcircuit = true;
-		free_winprop(&prop);
-		if (shortcircuit)
 			return false;
 	}
 
 	if (WMPSN_EWMH == ps->wmpsn) {
-		bool shortcircuit = false;
-		winprop_t prop = wid_get_prop(ps, wid, _NET_WM_STATE, 8192, XA_ATOM, 32);
-		{
-			long v = winprop_get_int(&prop);
-			if (_NET_WM_STATE_SKIP_TASKBAR == v
-			|| _NET_WM_STATE_HIDDEN == v
-			 || _NET_WM_STATE_SKIP_PAGER == v)
-				shortcircuit = true;
-		}
-		free_winprop(&prop);
-		if (shortcircuit)
+		long v = props->nstate ? props->state[0]: 0;
+		if (_NET_WM_STATE_SKIP_TASKBAR == v
+		|| _NET_WM_STATE_HIDDEN == v
+		 || _NET_WM_STATE_SKIP_PAGER == v)
 			return false;
 	}
 	else if (WMPSN_GNOME == ps->wmpsn) {
@@ -734,9 +1226,8 @@ wm_validate_window(session_t *ps, Window wid) {
 		bool filtering4float = false, floating = true;
 		bool filtering4max = false;
 		if (WMPSN_EWMH == ps->wmpsn) {
-			winprop_t prop = wid_get_prop(ps, wid, _NET_WM_STATE, 8192, XA_ATOM, 32);
-			for (int i = 0; i < prop.nitems; i++) {
-				long v = prop.data32[i];
+			for (int i = 0; i < props->nstate; i++) {
+				long v = props->state[i];
 				maxvert |= v == _NET_WM_STATE_MAXIMIZED_VERT;
 				maxhorz |= v == _NET_WM_STATE_MAXIMIZED_HORZ;
 
@@ -750,14 +1241,13 @@ wm_validate_window(session_t *ps, Window wid) {
 					}
 				}
 			}
-			if (prop.nitems == 0) {
+			if (props->nstate == 0) {
 				floating = true;
 				for (int j=0; j<ps->o.wm_status_count && !statusfilter; j++) {
 					if (ps->o.wm_status[j] == -1)
 						filtering4float = true;
 				}
 			}
-			free_winprop(&prop);
 		}
 		else if (WMPSN_GNOME == ps->wmpsn) {
 			winprop_t prop = wid_get_prop(ps, wid, _WIN_STATE, 1, XA_CARDINAL, 0);
@@ -792,59 +1282,49 @@ wm_validate_window(session_t *ps, Window wid) {
 	if (ps->o.wm_class) {
 		regex_t regex;
 		regcomp(&regex, ps->o.wm_class, REG_EXTENDED);
-		XClassHint *hints = allocchk(XAllocClassHint());
-		if (hints){
-			XGetClassHint(ps->dpy, wid, hints);
-			int regmatch_class = hints->res_class? regexec(&regex, hints->res_class, 0, NULL, 0): REG_NOMATCH;
-			int regmatch_name  = hints->res_name? regexec(&regex, hints->res_name,  0, NULL, 0): REG_NOMATCH;
-			if (regmatch_class != 0 && regmatch_name != 0)
-				return false;
-			XFree(hints->res_name);
-			XFree(hints->res_class);
-			XFree(hints);
-		}
+		int regmatch_class = props->res_class? regexec(&regex, props->res_class, 0, NULL, 0): REG_NOMATCH;
+		int regmatch_name  = props->res_name? regexec(&regex, props->res_name,  0, NULL, 0): REG_NOMATCH;
 		regfree(&regex);
+		if (regmatch_class != 0 && regmatch_name != 0)
+			return false;
 	}
 
 	if (ps->o.wm_title) {
 		regex_t regex;
 		regcomp(&regex, ps->o.wm_title, REG_EXTENDED);
-		FcChar8 *win_title = wm_get_window_title(ps, wid, NULL);
-		if (regexec(&regex, (char*) win_title, 0, NULL, 0) != 0)
-			return false;
+		int regmatch_title = props->title? regexec(&regex, props->title, 0, NULL, 0): REG_NOMATCH;
 		regfree(&regex);
+		if (regmatch_title != 0)
+			return false;
 	}
 
 	return true;
 }
 
+bool
+wm_validate_window(session_t *ps, Window wid) {
+	unsigned which = WM_PROP_TYPE;
+	if (WMPSN_EWMH == ps->wmpsn)
+		which |= WM_PROP_STATE;
+	if (ps->o.wm_class)
+		which |= WM_PROP_CLASS;
+	if (ps->o.wm_title)
+		which |= WM_PROP_TITLE;
+
+	wm_props_t scratch;
+	wm_props_t *props = wm_props_get(ps, wid, which, &scratch);
+	bool valid = wm_validate_window_props(ps, wid, props);
+	wm_props_done(props, &scratch);
+
+	return valid;
+}
+
 long
 wm_get_window_desktop(session_t *ps, Window wid) {
-	long desktop = LONG_MIN;
-	winprop_t prop = { };
-
-	// Check for sticky window
-	if (WMPSN_GNOME == ps->wmpsn) {
-		prop = wid_get_prop(ps, wid, _WIN_STATE, 1, XA_CARDINAL, 0);
-		if (WIN_STATE_STICKY & winprop_get_int(&prop))
-			desktop = -1;
-		free_winprop(&prop);
-		if (LONG_MIN != desktop)
-			return desktop;
-	}
-
-	prop = wid_get_prop(ps, wid, _NET_WM_DESKTOP, 1, XA_CARDINAL, 0);
-	if (prop.nitems)
-		desktop = winprop_get_int(&prop);
-	if ((long) 0xFFFFFFFFL == desktop)
-		desktop = -1;
-	free_winprop(&prop);
-	if (LONG_MIN != desktop) return desktop;
-
-	prop = wid_get_prop(ps, wid, _WIN_WORKSPACE, 1, XA_CARDINAL, 0);
-	if (prop.nitems)
-		desktop = winprop_get_int(&prop);
-	free_winprop(&prop);
+	wm_props_t scratch;
+	wm_props_t *props = wm_props_get(ps, wid, WM_PROP_DESKTOP, &scratch);
+	long desktop = props->desktop;
+	wm_props_done(props, &scratch);
 	if (LONG_MIN != desktop) return desktop;
 
 	return wm_get_current_desktop(ps);
@@ -1018,6 +1498,11 @@ wm_send_clientmsg(session_t *ps, Window twid, Window wid, Atom msg_type,
  */
 Window
 wm_find_frame(session_t *ps, Window wid) {
+	Window frame = (Window) winmap_get(ps->client_frame, wid);
+	if (frame)
+		return frame;
+
+	Window client = wid;
   // We traverse through its ancestors to find out the frame
   for (Window cwid = wid; cwid && cwid != ps->root; ) {
     Window rroot = None;
@@ -1028,6 +1513,8 @@ wm_find_frame(session_t *ps, Window wid) {
           &nchildren))
 			cwid = 0;
     sxfree(children);
+	if (cwid == ps->root)
+		wm_frames_link(ps, wid, client);
   }
 
   return wid;
@@ -59,6 +59,30 @@ typedef struct {
   int format;
 } winprop_t;
 
+/// Properties of a client window, fetched when first needed and kept
+/// until a PropertyNotify for one of them arrives.
+typedef struct {
+  /// WM_PROP_* bits of the fields holding a value
+  unsigned valid;
+  /// desktop set on the window, LONG_MIN if none
+  long desktop;
+  /// first atom of _NET_WM_WINDOW_TYPE, 0 if none
+  long wintype;
+  /// atoms of _NET_WM_STATE
+  long *state;
+  int nstate;
+  /// WM_CLASS parts, NULL if missing
+  char *res_class, *res_name;
+  /// title, NULL if missing
+  char *title;
+} wm_props_t;
+
+#define WM_PROP_DESKTOP (1 << 0)
+#define WM_PROP_TYPE    (1 << 1)
+#define WM_PROP_STATE   (1 << 2)
+#define WM_PROP_CLASS   (1 << 3)
+#define WM_PROP_TITLE   (1 << 4)
+
 void wm_get_atoms(session_t *ps);
 int wm_get_status(char *status);
 Atom status2atom(int status);
@@ -82,7 +106,7 @@ wm_check(session_t *ps) {
 	return false;
 }
 
-dlist *wm_get_stack(session_t *ps);
+Window *wm_get_stack(session_t *ps, int *n);
 Pixmap wm_get_root_pmap(Display *dpy);
 unsigned long wm_get_desktops(session_t *ps);
 long wm_get_current_desktop(session_t *ps);
@@ -95,6 +119,10 @@ void wm_set_fullscreen(session_t *ps, Window window,
 wintype_t wm_identify_panel(session_t *ps, Window wid);
 bool wm_validate_window(session_t *ps, Window wid);
 long wm_get_window_desktop(session_t *ps, Window wid);
+void wm_get_window_class(session_t *ps, Window wid, char **res_class, char **res_name);
+void wm_props_prefetch(session_t *ps, dlist *clients, unsigned which);
+void wm_props_invalidate(session_t *ps, Window wid, Atom atom);
+void wm_props_free(wm_props_t *props);
 Window wm_get_focused(session_t *ps);
 
 char *wm_wid_get_prop_rstr(session_t *ps, Window wid, Atom prop);
@@ -151,6 +179,8 @@ wm_activate_window_ewmh(session_t *ps, Window wid) {
 static inline void
 wm_set_desktop_ewmh(session_t *ps, long desktop) {
 	long data[] = { desktop, CurrentTime };
+	// The WM switches asynchronously, so the next read goes to the server
+	ps->rootprops.valid &= ~ROOTPROP_CURRENT_DESKTOP;
 	wm_send_clientmsg_ewmh_root(ps, ps->root, _NET_CURRENT_DESKTOP,
 			CARR_LEN(data), data);
 }
@@ -175,6 +205,7 @@ wm_activate_window(session_t *ps, Window wid) {
 }
 
 Window wm_find_frame(session_t *ps, Window wid);
+void wm_frames_track(session_t *ps, const XEvent *ev);
 
 /**
  * Determine if a window has a specific property.